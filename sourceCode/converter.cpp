@@ -0,0 +1,203 @@
+// simAssimpConverter: converts all files of a directory tree that Assimp can read into mesh caches
+// (see meshConverter.h), without CoppeliaSim. Files are converted in parallel. The arguments have the
+// same meaning as for simAssimp.importShapes
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "meshConverter.h"
+
+std::mutex logMutex;
+bool silent=false;
+
+void converterLog(const std::string& txt)
+{
+    if (silent)
+        return;
+    std::lock_guard<std::mutex> lock(logMutex);
+    printf("%s\n",txt.c_str());
+}
+
+void printUsage()
+{
+    printf("usage: simAssimpConverter [arguments] <input directory> <output directory>\n");
+    printf("  --scaling <s>             0.0 for automatic (default)\n");
+    printf("  --upVector <auto|z|y>     default is auto\n");
+    printf("  --options <n>             import flags, as for simAssimp.importShapes (32, 64 and 4096 apply when importing the cache)\n");
+    printf("  --maxTextureSize <n>      for textures embedded uncompressed. Default is 512\n");
+    printf("  --textureScaling <n>      see simAssimp.importShapes\n");
+    printf("  --weldTolerance <d>       0.0 to disable (default)\n");
+    printf("  --maxTileTriangles <n>    0 to disable (default)\n");
+    printf("Output files keep the relative path of their source, with .%s appended\n",meshCacheExtension);
+}
+
+struct SConversion
+{
+    std::filesystem::path input;
+    std::filesystem::path output;
+    bool ok;
+    std::string error;
+};
+
+void convertFile(SConversion& c,double scaling,int upVector,int options,int maxTextureSize,int textureScaling,int maxTileTriangles,double weldTolerance)
+{ // scaling and upVector are by value: automatic values are picked per file
+    SImportSource source;
+    source.filename=c.input.u8string();
+    source.buffer=nullptr;
+    source.bufferSize=0;
+    source.name=source.filename;
+    PooledImporter importer=acquireImporter();
+    int flags=prepareImporter(*importer,options);
+    const aiScene* scene=readScene(*importer,source,flags);
+    if (scene==nullptr)
+    {
+        c.error=importer->GetErrorString();
+        return;
+    }
+    transformVertices(scene,scaling,upVector);
+    std::vector<SImportMesh> meshes;
+    std::vector<SImportTexture> textures;
+    bool hasMaterials=extractMeshes(scene,source,importer->GetIOHandler(),scaling,upVector,options,meshes,textures);
+    importer.reset(); // frees the scene early
+    for (size_t i=0;i<textures.size();i++)
+    { // the cache must not depend on files next to the source. Compressed textures are decoded by the plugin
+        SImportTexture& t=textures[i];
+        std::vector<unsigned char> scaled;
+        int resOut[2];
+        if (t.filename.size()>0)
+            readTextureFile(t);
+        else if ( (t.image.size()>0)&&scaleTexture(t.image.data(),t.res,maxTextureSize,textureScaling,scaled,resOut) )
+        {
+            t.image.swap(scaled);
+            t.res[0]=resOut[0];
+            t.res[1]=resOut[1];
+        }
+    }
+    processMeshes(meshes,textures,maxTextureSize,options,maxTileTriangles,weldTolerance);
+    std::error_code ec;
+    std::filesystem::create_directories(c.output.parent_path(),ec);
+    if (!writeMeshCache(c.output.u8string(),meshes,textures,hasMaterials))
+    {
+        c.error="cannot write "+c.output.u8string();
+        return;
+    }
+    c.ok=true;
+}
+
+int main(int argc,char* argv[])
+{
+    double scaling=0.0;
+    int upVector=0;
+    int options=0;
+    int maxTextureSize=512;
+    int textureScaling=0;
+    double weldTolerance=0.0;
+    int maxTileTriangles=0;
+    std::vector<std::string> dirs;
+    for (int i=1;i<argc;i++)
+    {
+        std::string a(argv[i]);
+        bool hasValue=(i+1<argc);
+        if ( (a=="--scaling")&&hasValue )
+            scaling=atof(argv[++i]);
+        else if ( (a=="--upVector")&&hasValue )
+        {
+            std::string v(argv[++i]);
+            if (v=="auto")
+                upVector=0;
+            else if (v=="z")
+                upVector=1;
+            else if (v=="y")
+                upVector=2;
+            else
+                upVector=-1;
+        }
+        else if ( (a=="--options")&&hasValue )
+            options=atoi(argv[++i]);
+        else if ( (a=="--maxTextureSize")&&hasValue )
+            maxTextureSize=atoi(argv[++i]);
+        else if ( (a=="--textureScaling")&&hasValue )
+            textureScaling=atoi(argv[++i]);
+        else if ( (a=="--weldTolerance")&&hasValue )
+            weldTolerance=atof(argv[++i]);
+        else if ( (a=="--maxTileTriangles")&&hasValue )
+            maxTileTriangles=atoi(argv[++i]);
+        else if ( (a.size()>1)&&(a[0]=='-') )
+        {
+            printUsage();
+            return(2);
+        }
+        else
+            dirs.push_back(a);
+    }
+    if ( (dirs.size()!=2)||(scaling<0.0)||(upVector<0)||(options<0)||(maxTextureSize<8)||(textureScaling<0)||(textureScaling>6)||((textureScaling&3)==3)||(weldTolerance<0.0)||(maxTileTriangles<0) )
+    {
+        printUsage();
+        return(2);
+    }
+    silent=((options&256)!=0);
+
+    std::filesystem::path inputDir=std::filesystem::u8path(dirs[0]);
+    std::filesystem::path outputDir=std::filesystem::u8path(dirs[1]);
+    std::vector<SConversion> conversions;
+    {
+        PooledImporter importer=acquireImporter();
+        std::error_code ec;
+        for (std::filesystem::recursive_directory_iterator it(inputDir,ec),end;(!ec)&&(it!=end);it.increment(ec))
+        {
+            if (!it->is_regular_file())
+                continue;
+            std::string ext=it->path().extension().u8string();
+            if ( (ext.size()<2)||(!importer->IsExtensionSupported(ext)) )
+                continue;
+            SConversion c;
+            c.input=it->path();
+            c.output=outputDir/std::filesystem::relative(it->path(),inputDir);
+            c.output+=std::string(".")+meshCacheExtension; // keeps the source extension: a.obj and a.stl must not collide
+            c.ok=false;
+            conversions.push_back(c);
+        }
+        if (ec)
+        {
+            fprintf(stderr,"cannot read %s: %s\n",dirs[0].c_str(),ec.message().c_str());
+            return(1);
+        }
+    }
+
+    std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+    std::atomic<size_t> done(0);
+    parallelFor(conversions.size(),[&](size_t i)
+    { // one file per thread. The processing steps of a file then run serially (see parallelFor)
+        SConversion& c=conversions[i];
+        try
+        {
+            convertFile(c,scaling,upVector,options,maxTextureSize,textureScaling,maxTileTriangles,weldTolerance);
+        }
+        catch(std::exception& e)
+        {
+            c.error=e.what();
+        }
+        size_t d=++done;
+        converterLog("["+std::to_string(d)+"/"+std::to_string(conversions.size())+"] "+c.input.u8string()+(c.ok?"":" FAILED"));
+    });
+    double seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+    size_t failed=0;
+    for (size_t i=0;i<conversions.size();i++)
+    {
+        if (!conversions[i].ok)
+        {
+            fprintf(stderr,"%s: %s\n",conversions[i].input.u8string().c_str(),conversions[i].error.c_str());
+            failed++;
+        }
+    }
+    char txt[200];
+    snprintf(txt,sizeof(txt),"converted %zu of %zu files in %.2f s",conversions.size()-failed,conversions.size(),seconds);
+    converterLog(txt);
+    return((failed==0)?0:1);
+}
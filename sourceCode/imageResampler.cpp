@@ -0,0 +1,251 @@
+#include "imageResampler.h"
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#if defined(__SSE2__)||defined(_M_X64)||(defined(_M_IX86_FP)&&(_M_IX86_FP>=2))
+    #define RESAMPLER_SSE2
+    #include <emmintrin.h>
+#endif
+
+bool computeResampleTarget(const int* res,int maxSize,int targetMode,int* resOut)
+{
+    resOut[0]=res[0];
+    resOut[1]=res[1];
+    if (targetMode==resample_target_clamp)
+    {
+        resOut[0]=std::min<int>(maxSize,res[0]);
+        resOut[1]=std::min<int>(maxSize,res[1]);
+    }
+    else
+    {
+        int m=std::max<int>(res[0],res[1]);
+        if (m>maxSize)
+        {
+            resOut[0]=std::max<int>(1,int(double(res[0])*double(maxSize)/double(m)+0.5));
+            resOut[1]=std::max<int>(1,int(double(res[1])*double(maxSize)/double(m)+0.5));
+        }
+        if (targetMode==resample_target_pow2)
+        {
+            for (size_t i=0;i<2;i++)
+            {
+                int p=1;
+                while (p*2<=resOut[i])
+                    p*=2;
+                resOut[i]=p;
+            }
+        }
+    }
+    return( (resOut[0]!=res[0])||(resOut[1]!=res[1]) );
+}
+
+static void halveImage(const unsigned char* img,int w,int h,int channels,unsigned char* out)
+{ // 2x2 averaging, with rounding. An odd last row/column is dropped
+    int ow=w/2;
+    int oh=h/2;
+    for (int y=0;y<oh;y++)
+    {
+        const unsigned char* r0=img+size_t(2*y)*w*channels;
+        const unsigned char* r1=r0+size_t(w)*channels;
+        unsigned char* o=out+size_t(y)*ow*channels;
+        int x=0;
+#ifdef RESAMPLER_SSE2
+        if (channels==4)
+        { // 4 output pixels per iteration
+            const __m128i zero=_mm_setzero_si128();
+            const __m128i two=_mm_set1_epi16(2);
+            for (;x+4<=ow;x+=4)
+            {
+                __m128i a=_mm_loadu_si128((const __m128i*)(r0+8*x)); // 4 pixel pairs of row 0
+                __m128i b=_mm_loadu_si128((const __m128i*)(r1+8*x));
+                __m128i aLo=_mm_unpacklo_epi8(a,zero);
+                __m128i aHi=_mm_unpackhi_epi8(a,zero);
+                __m128i bLo=_mm_unpacklo_epi8(b,zero);
+                __m128i bHi=_mm_unpackhi_epi8(b,zero);
+                __m128i sLo=_mm_add_epi16(aLo,bLo); // pixels 0,1 (vertical sums)
+                __m128i sHi=_mm_add_epi16(aHi,bHi); // pixels 2,3
+                // horizontal sums: add the upper 64 bits (2nd pixel of each pair) to the lower ones
+                __m128i hLo=_mm_add_epi16(sLo,_mm_srli_si128(sLo,8));
+                __m128i hHi=_mm_add_epi16(sHi,_mm_srli_si128(sHi,8));
+                __m128i r=_mm_unpacklo_epi64(hLo,hHi);
+                r=_mm_srli_epi16(_mm_add_epi16(r,two),2);
+                __m128i packed=_mm_packus_epi16(r,zero);
+                _mm_storel_epi64((__m128i*)(o+4*x),packed);
+                // pairs 2,3 of this iteration
+                a=_mm_loadu_si128((const __m128i*)(r0+8*x+16));
+                b=_mm_loadu_si128((const __m128i*)(r1+8*x+16));
+                sLo=_mm_add_epi16(_mm_unpacklo_epi8(a,zero),_mm_unpacklo_epi8(b,zero));
+                sHi=_mm_add_epi16(_mm_unpackhi_epi8(a,zero),_mm_unpackhi_epi8(b,zero));
+                hLo=_mm_add_epi16(sLo,_mm_srli_si128(sLo,8));
+                hHi=_mm_add_epi16(sHi,_mm_srli_si128(sHi,8));
+                r=_mm_unpacklo_epi64(hLo,hHi);
+                r=_mm_srli_epi16(_mm_add_epi16(r,two),2);
+                packed=_mm_packus_epi16(r,zero);
+                _mm_storel_epi64((__m128i*)(o+4*x+8),packed);
+            }
+        }
+#endif
+        for (;x<ow;x++)
+        {
+            for (int c=0;c<channels;c++)
+            {
+                int s=r0[(2*x)*channels+c]+r0[(2*x+1)*channels+c]+r1[(2*x)*channels+c]+r1[(2*x+1)*channels+c];
+                o[x*channels+c]=(unsigned char)((s+2)>>2);
+            }
+        }
+    }
+}
+
+struct SContributions
+{ // for each output pixel: the first source pixel and the weights of the following ones
+    std::vector<int> first;
+    std::vector<int> count;
+    std::vector<float> weights;
+    std::vector<size_t> offsets;
+};
+
+static double sinc(double x)
+{
+    if (fabs(x)<1e-8)
+        return(1.0);
+    x*=3.14159265358979323846;
+    return(sin(x)/x);
+}
+
+static void computeContributions(int srcSize,int dstSize,int filter,SContributions& c)
+{
+    double scale=double(srcSize)/double(dstSize);
+    c.first.resize(dstSize);
+    c.count.resize(dstSize);
+    c.offsets.resize(dstSize);
+    c.weights.clear();
+    for (int x=0;x<dstSize;x++)
+    {
+        std::vector<double> w;
+        int first;
+        if (filter==resample_lanczos)
+        {
+            double support=3.0*std::max<double>(scale,1.0);
+            double center=(x+0.5)*scale;
+            first=std::max<int>(0,int(floor(center-support)));
+            int last=std::min<int>(srcSize-1,int(ceil(center+support)));
+            for (int i=first;i<=last;i++)
+            {
+                double t=(i+0.5-center)/std::max<double>(scale,1.0);
+                w.push_back( (fabs(t)<3.0)?sinc(t)*sinc(t/3.0):0.0 );
+            }
+        }
+        else
+        { // area: the overlap of each source pixel with the output pixel's footprint
+            double x0=x*scale;
+            double x1=std::min<double>((x+1)*scale,srcSize);
+            if (scale<1.0)
+            { // magnification: nearest
+                x0=std::min<double>(floor(x0),srcSize-1);
+                x1=x0+1.0;
+            }
+            first=int(floor(x0));
+            int last=std::min<int>(srcSize-1,int(ceil(x1))-1);
+            for (int i=first;i<=last;i++)
+                w.push_back(std::min<double>(i+1,x1)-std::max<double>(i,x0));
+        }
+        double sum=0.0;
+        for (size_t i=0;i<w.size();i++)
+            sum+=w[i];
+        c.first[x]=first;
+        c.count[x]=int(w.size());
+        c.offsets[x]=c.weights.size();
+        for (size_t i=0;i<w.size();i++)
+            c.weights.push_back(float( (sum!=0.0)?w[i]/sum:0.0 ));
+    }
+}
+
+static inline unsigned char toByte(float v)
+{
+    return((unsigned char)std::min<float>(255.0f,std::max<float>(0.0f,v+0.5f)));
+}
+
+static void resampleSeparable(const unsigned char* img,int w,int h,int channels,unsigned char* out,int ow,int oh,int filter)
+{ // horizontal pass into a float buffer, then vertical pass
+    SContributions cx,cy;
+    computeContributions(w,ow,filter,cx);
+    computeContributions(h,oh,filter,cy);
+    std::vector<float> tmp(size_t(ow)*h*channels);
+    for (int y=0;y<h;y++)
+    {
+        const unsigned char* row=img+size_t(y)*w*channels;
+        float* t=&tmp[size_t(y)*ow*channels];
+        for (int x=0;x<ow;x++)
+        {
+            const float* wt=&cx.weights[cx.offsets[x]];
+            const unsigned char* src=row+size_t(cx.first[x])*channels;
+#ifdef RESAMPLER_SSE2
+            if (channels==4)
+            {
+                __m128 acc=_mm_setzero_ps();
+                const __m128i zero=_mm_setzero_si128();
+                for (int i=0;i<cx.count[x];i++)
+                {
+                    int px;
+                    memcpy(&px,src+4*i,4);
+                    __m128i p=_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(px),zero),zero);
+                    acc=_mm_add_ps(acc,_mm_mul_ps(_mm_cvtepi32_ps(p),_mm_set1_ps(wt[i])));
+                }
+                _mm_storeu_ps(t+4*x,acc);
+                continue;
+            }
+#endif
+            for (int c=0;c<channels;c++)
+            {
+                float acc=0.0f;
+                for (int i=0;i<cx.count[x];i++)
+                    acc+=float(src[i*channels+c])*wt[i];
+                t[x*channels+c]=acc;
+            }
+        }
+    }
+    size_t rowSize=size_t(ow)*channels;
+    std::vector<float> acc(rowSize);
+    for (int y=0;y<oh;y++)
+    {
+        const float* wt=&cy.weights[cy.offsets[y]];
+        std::fill(acc.begin(),acc.end(),0.0f);
+        for (int i=0;i<cy.count[y];i++)
+        {
+            const float* src=&tmp[size_t(cy.first[y]+i)*rowSize];
+            size_t j=0;
+#ifdef RESAMPLER_SSE2
+            __m128 wv=_mm_set1_ps(wt[i]);
+            for (;j+4<=rowSize;j+=4)
+                _mm_storeu_ps(&acc[j],_mm_add_ps(_mm_loadu_ps(&acc[j]),_mm_mul_ps(_mm_loadu_ps(src+j),wv)));
+#endif
+            for (;j<rowSize;j++)
+                acc[j]+=src[j]*wt[i];
+        }
+        unsigned char* o=out+size_t(y)*rowSize;
+        for (size_t j=0;j<rowSize;j++)
+            o[j]=toByte(acc[j]);
+    }
+}
+
+void resampleImage(const unsigned char* img,const int* res,int channels,unsigned char* out,const int* resOut,int filter)
+{
+    int w=res[0];
+    int h=res[1];
+    std::vector<unsigned char> level;
+    std::vector<unsigned char> next;
+    const unsigned char* src=img;
+    while ( (w>=2*resOut[0])&&(h>=2*resOut[1])&&(w>1)&&(h>1) )
+    { // mip-style reduction
+        next.resize(size_t(w/2)*(h/2)*channels);
+        halveImage(src,w,h,channels,next.data());
+        level.swap(next);
+        src=level.data();
+        w/=2;
+        h/=2;
+    }
+    if ( (w==resOut[0])&&(h==resOut[1]) )
+        memcpy(out,src,size_t(w)*h*channels);
+    else
+        resampleSeparable(src,w,h,channels,out,resOut[0],resOut[1],filter);
+}
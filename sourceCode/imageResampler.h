@@ -0,0 +1,24 @@
+#pragma once
+
+// Image resampling on raw 8-bit buffers (RGB or RGBA, rows in buffer order), independent from the sim API.
+// Reductions first halve the image (2x2 averaging) as long as it stays at least twice the target size, then
+// finish with an exact area-average, or a Lanczos-3 filter
+
+enum
+{
+    resample_box=0,
+    resample_lanczos=1
+};
+
+enum
+{
+    resample_target_clamp=0, // each dimension clamped to the maximum size independently
+    resample_target_aspect=1, // aspect ratio preserved
+    resample_target_pow2=2 // aspect ratio preserved, then each dimension rounded down to a power of two
+};
+
+// Computes the target resolution of an image that should not exceed maxSize. Returns false if no scaling is needed
+bool computeResampleTarget(const int* res,int maxSize,int targetMode,int* resOut);
+
+// Resamples img (res[0] x res[1] pixels, channels 3 or 4) into out (resOut[0] x resOut[1] pixels)
+void resampleImage(const unsigned char* img,const int* res,int channels,unsigned char* out,const int* resOut,int filter);
@@ -0,0 +1,1677 @@
+#include "meshConverter.h"
+#include "mmapIOSystem.h"
+#include "imageResampler.h"
+#include <sstream>
+#include <fstream>
+#include <map>
+#include <array>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstring>
+#include <cmath>
+#include <cctype>
+#include <cfloat>
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <assimp/postprocess.h>
+#include <assimp/matrix4x4.h>
+#include <assimp/vector3.h>
+
+void splitString(const std::string& str,char delChar,std::vector<std::string>& words)
+{
+    std::stringstream ss(str);
+    std::string itm;
+    while (std::getline(ss,itm,delChar))
+        words.push_back(itm);
+}
+
+std::string toLowerCase(std::string str)
+{
+    for (size_t i=0;i<str.size();i++)
+        str[i]=char(tolower(str[i]));
+    return(str);
+}
+
+std::string normalizeExtension(const std::string& ext)
+{ // "*.OBJ", ".obj" and "obj" all become "obj"
+    size_t p=ext.find_last_of('.');
+    if (p!=std::string::npos)
+        return(toLowerCase(ext.substr(p+1)));
+    return(toLowerCase(ext));
+}
+
+std::mutex importerPoolMutex;
+std::vector<std::unique_ptr<Assimp::Importer>> importerPool;
+
+void SImporterRecycler::operator()(Assimp::Importer* importer) const
+{
+    importer->FreeScene();
+    std::lock_guard<std::mutex> lock(importerPoolMutex);
+    importerPool.emplace_back(importer);
+}
+
+PooledImporter acquireImporter()
+{
+    std::lock_guard<std::mutex> lock(importerPoolMutex);
+    if (importerPool.size()==0)
+    {
+        PooledImporter importer(new Assimp::Importer());
+        importer->SetIOHandler(new CMMapIOSystem()); // owned by the importer
+        return(importer);
+    }
+    PooledImporter retVal(importerPool.back().release());
+    importerPool.pop_back();
+    return(retVal);
+}
+
+void clearImporterPool()
+{
+    std::lock_guard<std::mutex> lock(importerPoolMutex);
+    importerPool.clear();
+}
+
+int prepareImporter(Assimp::Importer& importer,int& options)
+{ // returns the post-processing flags. All properties are set, since a pooled importer keeps them from previous use
+    CMMapIOSystem* io=dynamic_cast<CMMapIOSystem*>(importer.GetIOHandler());
+    if (io!=nullptr)
+        io->clearCache(); // files may have changed since the last read
+    importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS,aiComponent_ANIMATIONS|aiComponent_LIGHTS|aiComponent_CAMERAS);
+    importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE,aiPrimitiveType_POINT|aiPrimitiveType_LINE);
+    int flags=aiProcess_Triangulate|aiProcess_OptimizeGraph|
+            aiProcess_SortByPType|aiProcess_RemoveComponent|aiProcess_DropNormals|
+            aiProcess_RemoveRedundantMaterials|aiProcess_FindDegenerates|aiProcess_FindInvalidData|
+            aiProcess_GenUVCoords|aiProcess_TransformUVCoords|aiProcess_EmbedTextures;
+
+    if ((options&32)!=0)
+        options=(options|24)-24;
+    if ((options&8)==0)
+        flags|=aiProcess_OptimizeMeshes;
+    if ((options&16)==0)
+        flags|=aiProcess_JoinIdenticalVertices;
+
+    importer.SetPropertyInteger(AI_CONFIG_IMPORT_COLLADA_IGNORE_UP_DIRECTION,((options&128)!=0)?1:0);
+    return(flags);
+}
+
+std::vector<SImportSource> getFileSources(const char* fileNames)
+{
+    std::vector<std::string> filenames;
+    splitString(fileNames,';',filenames);
+    std::vector<SImportSource> sources;
+    for (size_t i=0;i<filenames.size();i++)
+    {
+        SImportSource source;
+        source.filename=filenames[i];
+        source.buffer=nullptr;
+        source.bufferSize=0;
+        source.name=filenames[i];
+        sources.push_back(source);
+    }
+    return(sources);
+}
+
+std::vector<SImportSource> getBufferSource(const char* buffer,size_t bufferSize,const char* formatHint)
+{
+    SImportSource source;
+    source.buffer=buffer;
+    source.bufferSize=bufferSize;
+    source.formatHint=normalizeExtension(formatHint);
+    source.name="buffer."+source.formatHint;
+    return(std::vector<SImportSource>(1,source));
+}
+
+const aiScene* readScene(Assimp::Importer& importer,const SImportSource& source,int flags)
+{
+    if (source.buffer!=nullptr)
+        return(importer.ReadFileFromMemory(source.buffer,source.bufferSize,flags,source.formatHint.c_str()));
+    return(importer.ReadFile(source.filename.c_str(),flags));
+}
+
+const aiMatrix4x4* getTransform(aiNode* node,const aiMatrix4x4* tr,int meshIndex)
+{
+    for (size_t i=0;i<node->mNumMeshes;i++)
+    {
+        if (node->mMeshes[i]==meshIndex)
+            return(tr);
+    }
+    for (size_t i=0;i<node->mNumChildren;i++)
+    {
+        aiNode* childNode=node->mChildren[i];
+        aiMatrix4x4 tr2=tr[0]*childNode->mTransformation;
+        const aiMatrix4x4* m=getTransform(childNode,&tr2,meshIndex);
+        if (m!=nullptr)
+            return(m);
+    }
+    return(nullptr);
+}
+
+void transformVertices(const aiScene* scene,double& scaling,int& upVector,double* boundingBox/*=nullptr*/)
+{ // applies the node transformations to the mesh vertices. Then picks the scaling and up-vector, if those are automatic (i.e. 0)
+  // boundingBox, if not null, receives the min x/y/z and max x/y/z of the transformed vertices
+    double minMaxX[2]={9999999.0,-9999999.0};
+    double minMaxY[2]={9999999.0,-9999999.0};
+    double minMaxZ[2]={9999999.0,-9999999.0};
+    for (size_t i=0;i<scene->mNumMeshes;i++)
+    {
+        const aiMatrix4x4* tr=getTransform(scene->mRootNode,&scene->mRootNode->mTransformation,i);
+        const aiMesh* mesh = scene->mMeshes[i];
+        for (size_t j=0;j<mesh->mNumVertices;j++)
+        {
+            if (tr!=nullptr)
+                mesh->mVertices[j]*=tr[0];
+            if (mesh->mVertices[j].x<minMaxX[0])
+                minMaxX[0]=mesh->mVertices[j].x;
+            if (mesh->mVertices[j].x>minMaxX[1])
+                minMaxX[1]=mesh->mVertices[j].x;
+            if (mesh->mVertices[j].y<minMaxY[0])
+                minMaxY[0]=mesh->mVertices[j].y;
+            if (mesh->mVertices[j].y>minMaxY[1])
+                minMaxY[1]=mesh->mVertices[j].y;
+            if (mesh->mVertices[j].z<minMaxZ[0])
+                minMaxZ[0]=mesh->mVertices[j].z;
+            if (mesh->mVertices[j].z>minMaxZ[1])
+                minMaxZ[1]=mesh->mVertices[j].z;
+        }
+    }
+    if (boundingBox!=nullptr)
+    {
+        double bb[6]={minMaxX[0],minMaxY[0],minMaxZ[0],minMaxX[1],minMaxY[1],minMaxZ[1]};
+        if (minMaxX[0]>minMaxX[1])
+            memset(bb,0,sizeof(bb)); // no vertices
+        memcpy(boundingBox,bb,sizeof(bb));
+    }
+    double l=std::max<double>(minMaxX[1]-minMaxX[0],std::max<double>(minMaxY[1]-minMaxY[0],minMaxZ[1]-minMaxZ[0]));
+    if (scaling==0.0)
+    {
+        scaling=1.0;
+        while (l>5.0)
+        {
+            l*=0.1;
+            scaling*=0.1;
+        }
+        while (l<0.05)
+        {
+            l*=10.0;
+            scaling*=10.0;
+        }
+    }
+    if (upVector==0)
+    {
+        if (minMaxZ[0]>=minMaxY[0])
+            upVector=1;
+        else
+            upVector=2;
+    }
+}
+
+bool scaleTexture(const unsigned char* img,const int* res,int maxSize,int textureScaling,std::vector<unsigned char>& out,int* resOut)
+{ // returns false if the RGBA texture can stay as is.
+  // textureScaling: 0-2: see resample_target_clamp/aspect/pow2, +4: Lanczos filter instead of area-averaging
+    if (!computeResampleTarget(res,maxSize,textureScaling&3,resOut))
+        return(false);
+    out.resize(4*size_t(resOut[0])*resOut[1]);
+    resampleImage(img,res,4,out.data(),resOut,((textureScaling&4)!=0)?resample_lanczos:resample_box);
+    return(true);
+}
+
+bool readTextureFile(SImportTexture& texture)
+{ // moves an external texture's content into data
+    std::ifstream f(std::filesystem::u8path(texture.filename),std::ios::binary);
+    if (!f)
+        return(false);
+    texture.data.assign(std::istreambuf_iterator<char>(f),std::istreambuf_iterator<char>());
+    texture.formatHint=normalizeExtension(texture.filename);
+    texture.filename.clear();
+    return(true);
+}
+
+std::string getSourceAlias(const SImportSource& source)
+{ // the file name, without path and extension
+    std::string alias(source.name);
+    std::size_t si=alias.find_last_of("/\\");
+    if (si!=std::string::npos)
+        alias=alias.substr(si+1);
+    si=alias.find_last_of(".");
+    if (si!=std::string::npos)
+        alias=alias.substr(0,si);
+    return(alias);
+}
+
+bool extractMeshes(const aiScene* scene,const SImportSource& source,Assimp::IOSystem* io,double scaling,int upVector,int options,std::vector<SImportMesh>& meshes,std::vector<SImportTexture>& textures)
+{
+    bool hasMaterials=false;
+    std::string shapeAlias(getSourceAlias(source));
+    std::map<std::string,int> textureIndices; // see SImportTexture::key
+    meshes.resize(scene->mNumMeshes);
+    for (size_t i=0;i<scene->mNumMeshes;i++)
+    {
+        const aiMesh* mesh = scene->mMeshes[i];
+        const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+        SImportMesh& m=meshes[i];
+        std::vector<double>& vertices=m.vertices;
+        std::vector<int>& indices=m.indices;
+        vertices.reserve(3*mesh->mNumVertices);
+        indices.reserve(3*mesh->mNumFaces);
+        for (size_t j=0;j<mesh->mNumVertices;j++)
+        {
+            if (upVector==1)
+            {
+                vertices.push_back(mesh->mVertices[j].x*scaling);
+                vertices.push_back(mesh->mVertices[j].y*scaling);
+                vertices.push_back(mesh->mVertices[j].z*scaling);
+            }
+            else
+            {
+                vertices.push_back(mesh->mVertices[j].x*scaling);
+                vertices.push_back(-mesh->mVertices[j].z*scaling);
+                vertices.push_back(mesh->mVertices[j].y*scaling);
+            }
+        }
+        for (size_t j=0;j<mesh->mNumFaces;j++)
+        {
+            const aiFace& face=mesh->mFaces[j];
+            indices.push_back(face.mIndices[0]);
+            indices.push_back(face.mIndices[1]);
+            indices.push_back(face.mIndices[2]);
+        }
+
+        // Ok, we have vertices and indices ready. What about a texture?
+        m.texture=-1;
+        m.tileGroup=-1;
+        aiString texPath;
+        bool hasTexture=false;
+        if ( ((options&1)==0)&&(mesh->HasTextureCoords(0))&&(aiReturn_SUCCESS==aiGetMaterialTexture(material,aiTextureType_DIFFUSE,0,&texPath)) )
+        {
+            std::vector<float>& _textureCoords=m.textureCoords;
+            for (size_t j=0;j<indices.size();j++)
+            {
+                int index=indices[j];
+                const aiVector3D& textureVect=mesh->mTextureCoords[0][index];
+                _textureCoords.push_back(float(textureVect.x));
+                _textureCoords.push_back(float(textureVect.y));
+            }
+            std::string p=std::string(texPath.C_Str());
+            const aiTexture* texture=nullptr;
+            if ( (p.size()>1)&&(p[0]=='*') )
+                texture=scene->mTextures[std::stoi(p.substr(1))];
+            std::string key;
+            if (texture==nullptr)
+            {
+                if (source.filename.size()>0)
+                { // external texture, next to the file
+                    std::filesystem::path pp(source.filename);
+                    pp=pp.parent_path();
+                    std::string loc[6]={pp.string()+"/"+p,pp.string()+"/textures/"+p,pp.string()+"/../"+p,pp.string()+"/../textures/"+p,pp.string()+"/../materials/"+p,pp.string()+"/../materials/textures/"+p};
+                    for (size_t fi=0;fi<6;fi++)
+                    {
+                        if (io->Exists(loc[fi].c_str()))
+                            key=loc[fi];
+                    }
+                }
+            }
+            else
+                key=p;
+            if ( (_textureCoords.size()>0)&&(key.size()>0) )
+            {
+                std::map<std::string,int>::iterator textIt=textureIndices.find(key);
+                if (textIt==textureIndices.end())
+                {
+                    SImportTexture t;
+                    t.key=key;
+                    t.res[0]=0;
+                    t.res[1]=0;
+                    if (texture==nullptr)
+                        t.filename=key;
+                    else if (texture->mHeight==0)
+                    {
+                        t.data.assign((const char*)texture->pcData,texture->mWidth);
+                        t.formatHint=texture->achFormatHint;
+                    }
+                    else
+                    {
+                        t.res[0]=texture->mWidth;
+                        t.res[1]=texture->mHeight;
+                        t.image.assign((const unsigned char*)texture->pcData,(const unsigned char*)texture->pcData+4*size_t(t.res[0])*t.res[1]);
+                    }
+                    textIt=textureIndices.insert(std::make_pair(key,int(textures.size()))).first;
+                    textures.push_back(std::move(t));
+                }
+                hasTexture=true;
+                hasMaterials=true;
+                m.texture=textIt->second;
+            }
+        }
+        if (m.texture<0)
+            m.textureCoords.clear();
+
+        m.alias=shapeAlias;
+        if (scene->mNumMeshes>1)
+        {
+            m.alias+="_";
+            m.alias+=std::to_string(i);
+        }
+
+        aiColor3D colorA(0.499,0.499,0.499);
+        aiColor3D colorD(0.499,0.499,0.499);
+        aiColor3D colorS(0.0,0.0,0.0);
+        aiColor3D colorE(0.0,0.0,0.0);
+        if ((options&2)==0)
+        {
+            material->Get(AI_MATKEY_COLOR_AMBIENT,colorA);
+            material->Get(AI_MATKEY_COLOR_DIFFUSE,colorD);
+            material->Get(AI_MATKEY_COLOR_SPECULAR,colorS);
+            material->Get(AI_MATKEY_COLOR_EMISSIVE,colorE);
+        }
+        double opacity=1.0;
+        if ((options&4)==0)
+            material->Get(AI_MATKEY_OPACITY,opacity);
+        float ca[3]={(float)colorA.r,(float)colorA.g,(float)colorA.b};
+        float cd[3]={(float)colorD.r,(float)colorD.g,(float)colorD.b};
+        if ( hasTexture&&(ca[0]==0.0f)&&(ca[1]==0.0f)&&(ca[2]==0.0f) )
+        {
+            ca[0]=0.499f;
+            ca[1]=0.499f;
+            ca[2]=0.499f;
+        }
+        for (size_t k=0;k<3;k++)
+            m.colorAD[k]=std::max<float>(ca[k],cd[k]);
+        m.colorS[0]=(float)colorS.r;
+        m.colorS[1]=(float)colorS.g;
+        m.colorS[2]=(float)colorS.b;
+        m.colorE[0]=(float)colorE.r;
+        m.colorE[1]=(float)colorE.g;
+        m.colorE[2]=(float)colorE.b;
+        if ( (ca[0]!=0.499f)||(ca[1]!=0.499f)||(ca[2]!=0.499f) )
+            hasMaterials=true;
+        if ( (cd[0]!=0.499f)||(cd[1]!=0.499f)||(cd[2]!=0.499f) )
+            hasMaterials=true;
+        m.transparency=float(1.0-opacity);
+    }
+    return(hasMaterials);
+}
+
+void splitIntoTiles(const std::vector<double>& centroids,std::vector<int>& triangles,size_t first,size_t last,int maxTriangles,std::vector<std::pair<size_t,size_t>>& tiles)
+{ // recursively halves the bounding box of the triangle centroids along its longest side, until each cell holds at most maxTriangles
+    if (last-first<=size_t(maxTriangles))
+    {
+        tiles.push_back(std::make_pair(first,last));
+        return;
+    }
+    double minV[3]={DBL_MAX,DBL_MAX,DBL_MAX};
+    double maxV[3]={-DBL_MAX,-DBL_MAX,-DBL_MAX};
+    for (size_t i=first;i<last;i++)
+    {
+        const double* c=&centroids[3*triangles[i]];
+        for (size_t k=0;k<3;k++)
+        {
+            minV[k]=std::min<double>(minV[k],c[k]);
+            maxV[k]=std::max<double>(maxV[k],c[k]);
+        }
+    }
+    int axis=0;
+    if (maxV[1]-minV[1]>maxV[axis]-minV[axis])
+        axis=1;
+    if (maxV[2]-minV[2]>maxV[axis]-minV[axis])
+        axis=2;
+    double mid=0.5*(minV[axis]+maxV[axis]);
+    std::vector<int>::iterator m=std::partition(triangles.begin()+first,triangles.begin()+last,[&](int t){ return(centroids[3*t+axis]<mid); });
+    size_t split=size_t(m-triangles.begin());
+    if ( (split==first)||(split==last) )
+    { // all centroids coincide along that axis (or very unbalanced data): fall back to a median split
+        split=first+(last-first)/2;
+        std::nth_element(triangles.begin()+first,triangles.begin()+split,triangles.begin()+last,[&](int a,int b){ return(centroids[3*a+axis]<centroids[3*b+axis]); });
+    }
+    splitIntoTiles(centroids,triangles,first,split,maxTriangles,tiles);
+    splitIntoTiles(centroids,triangles,split,last,maxTriangles,tiles);
+}
+
+void buildTile(const SImportMesh& mesh,const std::vector<int>& triangles,size_t first,size_t last,SImportMesh& tile)
+{ // each triangle belongs to exactly one tile (the one containing its centroid). Vertices on tile borders are duplicated, so tiles are watertight where the source was
+    std::vector<int> used;
+    used.reserve(3*(last-first));
+    for (size_t i=first;i<last;i++)
+    {
+        for (size_t k=0;k<3;k++)
+            used.push_back(mesh.indices[3*triangles[i]+k]);
+    }
+    std::sort(used.begin(),used.end());
+    used.erase(std::unique(used.begin(),used.end()),used.end());
+    tile.vertices.resize(3*used.size());
+    for (size_t i=0;i<used.size();i++)
+    {
+        for (size_t k=0;k<3;k++)
+            tile.vertices[3*i+k]=mesh.vertices[3*used[i]+k];
+    }
+    tile.indices.resize(3*(last-first));
+    if (mesh.textureCoords.size()>0)
+        tile.textureCoords.resize(6*(last-first));
+    for (size_t i=first;i<last;i++)
+    {
+        int t=triangles[i];
+        for (size_t k=0;k<3;k++)
+        {
+            tile.indices[3*(i-first)+k]=int(std::lower_bound(used.begin(),used.end(),mesh.indices[3*t+k])-used.begin());
+            if (mesh.textureCoords.size()>0)
+            {
+                tile.textureCoords[6*(i-first)+2*k+0]=mesh.textureCoords[6*t+2*k+0];
+                tile.textureCoords[6*(i-first)+2*k+1]=mesh.textureCoords[6*t+2*k+1];
+            }
+        }
+    }
+}
+
+void tileMeshes(std::vector<SImportMesh>& meshes,int maxTriangles)
+{ // replaces meshes with more than maxTriangles triangles by their spatial tiles
+    std::vector<std::vector<int>> triangles(meshes.size());
+    std::vector<std::vector<std::pair<size_t,size_t>>> tiles(meshes.size());
+    parallelFor(meshes.size(),[&](size_t i)
+    {
+        const SImportMesh& mesh=meshes[i];
+        size_t triCnt=mesh.indices.size()/3;
+        if (triCnt<=size_t(maxTriangles))
+            return;
+        std::vector<double> centroids(3*triCnt);
+        for (size_t t=0;t<triCnt;t++)
+        {
+            for (size_t k=0;k<3;k++)
+                centroids[3*t+k]=(mesh.vertices[3*mesh.indices[3*t+0]+k]+mesh.vertices[3*mesh.indices[3*t+1]+k]+mesh.vertices[3*mesh.indices[3*t+2]+k])/3.0;
+        }
+        triangles[i].resize(triCnt);
+        for (size_t t=0;t<triCnt;t++)
+            triangles[i][t]=int(t);
+        splitIntoTiles(centroids,triangles[i],0,triCnt,maxTriangles,tiles[i]);
+    });
+
+    std::vector<SImportMesh> result;
+    std::vector<std::pair<size_t,size_t>> tileSources; // mesh index, tile index
+    for (size_t i=0;i<meshes.size();i++)
+    {
+        if (tiles[i].size()==0)
+            result.push_back(std::move(meshes[i]));
+        else
+        {
+            for (size_t j=0;j<tiles[i].size();j++)
+            {
+                SImportMesh tile;
+                tile.alias=meshes[i].alias+"_tile"+std::to_string(j);
+                tile.texture=meshes[i].texture;
+                for (size_t k=0;k<3;k++)
+                {
+                    tile.colorAD[k]=meshes[i].colorAD[k];
+                    tile.colorS[k]=meshes[i].colorS[k];
+                    tile.colorE[k]=meshes[i].colorE[k];
+                }
+                tile.transparency=meshes[i].transparency;
+                tile.tileGroup=int(i);
+                tileSources.push_back(std::make_pair(i,result.size()));
+                result.push_back(std::move(tile));
+            }
+        }
+    }
+    std::vector<size_t> tileCounters(meshes.size(),0);
+    std::vector<size_t> tileIndices(tileSources.size());
+    for (size_t i=0;i<tileSources.size();i++)
+        tileIndices[i]=tileCounters[tileSources[i].first]++;
+    parallelFor(tileSources.size(),[&](size_t i)
+    {
+        size_t m=tileSources[i].first;
+        const std::pair<size_t,size_t>& range=tiles[m][tileIndices[i]];
+        buildTile(meshes[m],triangles[m],range.first,range.second,result[tileSources[i].second]);
+    });
+    meshes.swap(result);
+}
+
+struct STriangleKey
+{
+    int v[3];
+    bool operator==(const STriangleKey& o) const { return( (v[0]==o.v[0])&&(v[1]==o.v[1])&&(v[2]==o.v[2]) ); }
+};
+struct STriangleKeyHash
+{
+    size_t operator()(const STriangleKey& k) const { return(size_t(k.v[0])*2654435761u^size_t(k.v[1])*40503u^size_t(k.v[2])); }
+};
+
+SWeldStats weldMesh(std::vector<double>& vertices,std::vector<int>& indices,std::vector<float>* textureCoords,double tolerance,std::vector<int>* vertexOrigins/*=nullptr*/)
+{ // merges vertices closer than tolerance (hash grid with cell size=tolerance), then removes collapsed, zero-area and duplicate triangles, and unused vertices.
+  // textureCoords (2 per index) follow their triangles. vertexOrigins receives, for each remaining vertex, the index of the original vertex it was taken from
+    SWeldStats stats;
+    size_t vertexCnt=vertices.size()/3;
+    size_t triangleCnt=indices.size()/3;
+    double tol2=tolerance*tolerance;
+    std::unordered_map<SWeldCell,std::vector<int>,SWeldCellHash> grid;
+    grid.reserve(vertexCnt);
+    std::vector<int> remap(vertexCnt);
+    std::vector<double> welded;
+    welded.reserve(vertices.size());
+    std::vector<int> origins;
+    origins.reserve(vertexCnt);
+    for (size_t i=0;i<vertexCnt;i++)
+    {
+        const double* v=&vertices[3*i];
+        SWeldCell cell;
+        for (size_t k=0;k<3;k++)
+            cell.c[k]=(long long)std::floor(v[k]/tolerance);
+        int found=-1;
+        for (int dx=-1;(dx<=1)&&(found<0);dx++)
+        {
+            for (int dy=-1;(dy<=1)&&(found<0);dy++)
+            {
+                for (int dz=-1;(dz<=1)&&(found<0);dz++)
+                {
+                    SWeldCell n={{cell.c[0]+dx,cell.c[1]+dy,cell.c[2]+dz}};
+                    std::unordered_map<SWeldCell,std::vector<int>,SWeldCellHash>::const_iterator it=grid.find(n);
+                    if (it==grid.end())
+                        continue;
+                    for (size_t j=0;j<it->second.size();j++)
+                    {
+                        const double* w=&welded[3*it->second[j]];
+                        double d2=(v[0]-w[0])*(v[0]-w[0])+(v[1]-w[1])*(v[1]-w[1])+(v[2]-w[2])*(v[2]-w[2]);
+                        if (d2<=tol2)
+                        {
+                            found=it->second[j];
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        if (found<0)
+        {
+            found=int(origins.size());
+            welded.insert(welded.end(),v,v+3);
+            origins.push_back(int(i));
+            grid[cell].push_back(found);
+        }
+        remap[i]=found;
+    }
+
+    std::unordered_set<STriangleKey,STriangleKeyHash> triangles;
+    triangles.reserve(triangleCnt);
+    size_t keptCnt=0;
+    for (size_t t=0;t<triangleCnt;t++)
+    {
+        int a=remap[indices[3*t+0]];
+        int b=remap[indices[3*t+1]];
+        int c=remap[indices[3*t+2]];
+        if ( (a==b)||(b==c)||(c==a) )
+            continue; // collapsed
+        const double* pa=&welded[3*a];
+        const double* pb=&welded[3*b];
+        const double* pc=&welded[3*c];
+        double e1[3]={pb[0]-pa[0],pb[1]-pa[1],pb[2]-pa[2]};
+        double e2[3]={pc[0]-pa[0],pc[1]-pa[1],pc[2]-pa[2]};
+        double n[3]={e1[1]*e2[2]-e1[2]*e2[1],e1[2]*e2[0]-e1[0]*e2[2],e1[0]*e2[1]-e1[1]*e2[0]};
+        if (n[0]*n[0]+n[1]*n[1]+n[2]*n[2]<=DBL_EPSILON*DBL_EPSILON*(e1[0]*e1[0]+e1[1]*e1[1]+e1[2]*e1[2])*(e2[0]*e2[0]+e2[1]*e2[1]+e2[2]*e2[2]))
+            continue; // zero area
+        STriangleKey key={{a,b,c}}; // rotated so that the smallest index comes first. The winding is kept, so that double-sided faces survive
+        if ( (b<a)&&(b<c) )
+            key={{b,c,a}};
+        else if ( (c<a)&&(c<b) )
+            key={{c,a,b}};
+        if (!triangles.insert(key).second)
+            continue; // duplicate
+        indices[3*keptCnt+0]=a;
+        indices[3*keptCnt+1]=b;
+        indices[3*keptCnt+2]=c;
+        if ( (textureCoords!=nullptr)&&(textureCoords->size()>0) )
+        {
+            for (size_t k=0;k<6;k++)
+                textureCoords[0][6*keptCnt+k]=textureCoords[0][6*t+k];
+        }
+        keptCnt++;
+    }
+    indices.resize(3*keptCnt);
+    if ( (textureCoords!=nullptr)&&(textureCoords->size()>0) )
+        textureCoords->resize(6*keptCnt);
+
+    // Drop vertices that only removed triangles used:
+    std::vector<int> used(origins.size(),-1);
+    int usedCnt=0;
+    for (size_t i=0;i<indices.size();i++)
+    {
+        if (used[indices[i]]<0)
+            used[indices[i]]=0;
+    }
+    for (size_t i=0;i<used.size();i++)
+    {
+        if (used[i]==0)
+        {
+            used[i]=usedCnt;
+            welded[3*usedCnt+0]=welded[3*i+0];
+            welded[3*usedCnt+1]=welded[3*i+1];
+            welded[3*usedCnt+2]=welded[3*i+2];
+            origins[usedCnt]=origins[i];
+            usedCnt++;
+        }
+    }
+    welded.resize(3*usedCnt);
+    origins.resize(usedCnt);
+    for (size_t i=0;i<indices.size();i++)
+        indices[i]=used[indices[i]];
+
+    stats.removedVertices=vertexCnt-size_t(usedCnt);
+    stats.removedTriangles=triangleCnt-keptCnt;
+    vertices.swap(welded);
+    if (vertexOrigins!=nullptr)
+        vertexOrigins->swap(origins);
+    return(stats);
+}
+
+void logWeldStats(const std::vector<SWeldStats>& stats)
+{
+    size_t v=0;
+    size_t t=0;
+    for (size_t i=0;i<stats.size();i++)
+    {
+        v+=stats[i].removedVertices;
+        t+=stats[i].removedTriangles;
+    }
+    std::string txt("welding removed ");
+    txt+=std::to_string(v)+" vertices and "+std::to_string(t)+" triangles";
+    converterLog(txt);
+}
+
+void weldMeshes(std::vector<SImportMesh>& meshes,double tolerance,int options)
+{
+    std::vector<SWeldStats> stats(meshes.size());
+    parallelFor(meshes.size(),[&](size_t i)
+    {
+        stats[i]=weldMesh(meshes[i].vertices,meshes[i].indices,&meshes[i].textureCoords,tolerance);
+    });
+    if ((options&256)==0)
+        logWeldStats(stats);
+}
+
+SWeldStats weldMesh(aiMesh* mesh,double tolerance)
+{ // in-place, in the mesh's own units
+    std::vector<double> vertices(3*mesh->mNumVertices);
+    for (size_t i=0;i<mesh->mNumVertices;i++)
+    {
+        vertices[3*i+0]=mesh->mVertices[i].x;
+        vertices[3*i+1]=mesh->mVertices[i].y;
+        vertices[3*i+2]=mesh->mVertices[i].z;
+    }
+    std::vector<int> indices(3*mesh->mNumFaces);
+    for (size_t i=0;i<mesh->mNumFaces;i++)
+    {
+        indices[3*i+0]=mesh->mFaces[i].mIndices[0];
+        indices[3*i+1]=mesh->mFaces[i].mIndices[1];
+        indices[3*i+2]=mesh->mFaces[i].mIndices[2];
+    }
+    std::vector<int> origins;
+    SWeldStats stats=weldMesh(vertices,indices,nullptr,tolerance,&origins);
+
+    // Vertices are only ever removed, so the existing arrays are compacted in place:
+    for (size_t i=0;i<origins.size();i++)
+    {
+        mesh->mVertices[i]=aiVector3D(ai_real(vertices[3*i+0]),ai_real(vertices[3*i+1]),ai_real(vertices[3*i+2]));
+        for (size_t j=0;j<AI_MAX_NUMBER_OF_TEXTURECOORDS;j++)
+        {
+            if (mesh->mTextureCoords[j]!=nullptr)
+                mesh->mTextureCoords[j][i]=mesh->mTextureCoords[j][origins[i]];
+        }
+        for (size_t j=0;j<AI_MAX_NUMBER_OF_COLOR_SETS;j++)
+        {
+            if (mesh->mColors[j]!=nullptr)
+                mesh->mColors[j][i]=mesh->mColors[j][origins[i]];
+        }
+    }
+    mesh->mNumVertices=(unsigned int)origins.size();
+    delete[] mesh->mFaces;
+    mesh->mNumFaces=(unsigned int)(indices.size()/3);
+    mesh->mFaces=new aiFace[mesh->mNumFaces];
+    for (size_t i=0;i<mesh->mNumFaces;i++)
+    {
+        aiFace& face=mesh->mFaces[i];
+        face.mNumIndices=3;
+        face.mIndices=new unsigned int[3];
+        face.mIndices[0]=indices[3*i+0];
+        face.mIndices[1]=indices[3*i+1];
+        face.mIndices[2]=indices[3*i+2];
+    }
+    return(stats);
+}
+
+// Cache-locality reordering: triangles are first sorted along a Morton curve of their centroids, then reordered
+// for a vertex cache (Forsyth's linear-speed algorithm, restarting in Morton order when stuck). Finally, vertices
+// are renumbered in order of first use, so that consecutive triangles reference nearby vertex data.
+// The logged ACMR only measures the locality of the index buffer (vertex-cache misses, hence vertex memory reads, per
+// triangle). It is not a measurement of how fast the simulator's collision, distance or ray queries run on the shape
+double computeAcmr(const std::vector<int>& indices,size_t vertexCnt)
+{ // average cache miss ratio, for a FIFO cache of 32 vertices. 0.5 is the ideal, 3.0 the worst
+    const size_t cacheSize=32;
+    std::vector<size_t> insertedAt(vertexCnt,0); // 1-based time of insertion, 0 if never inserted
+    size_t misses=0;
+    for (size_t i=0;i<indices.size();i++)
+    {
+        size_t& t=insertedAt[indices[i]];
+        if ( (t==0)||(misses+1-t>=cacheSize+1) )
+        { // misses+1 is the time of the next insertion
+            misses++;
+            t=misses;
+        }
+    }
+    if (indices.size()<3)
+        return(0.0);
+    return(double(misses)/double(indices.size()/3));
+}
+
+unsigned int mortonPart(unsigned int v)
+{ // spreads the 10 lower bits of v, 2 zeros between each bit
+    v&=1023;
+    v=(v|(v<<16))&0x030000FF;
+    v=(v|(v<<8))&0x0300F00F;
+    v=(v|(v<<4))&0x030C30C3;
+    v=(v|(v<<2))&0x09249249;
+    return(v);
+}
+
+void sortTrianglesMorton(const std::vector<double>& vertices,const std::vector<int>& indices,std::vector<int>& triangleOrder)
+{
+    size_t triCnt=indices.size()/3;
+    double bbMin[3]={DBL_MAX,DBL_MAX,DBL_MAX};
+    double bbMax[3]={-DBL_MAX,-DBL_MAX,-DBL_MAX};
+    for (size_t i=0;i<vertices.size()/3;i++)
+    {
+        for (size_t k=0;k<3;k++)
+        {
+            bbMin[k]=std::min<double>(bbMin[k],vertices[3*i+k]);
+            bbMax[k]=std::max<double>(bbMax[k],vertices[3*i+k]);
+        }
+    }
+    std::vector<std::pair<unsigned int,int>> codes(triCnt);
+    for (size_t t=0;t<triCnt;t++)
+    {
+        unsigned int c[3];
+        for (size_t k=0;k<3;k++)
+        {
+            double centroid=(vertices[3*indices[3*t+0]+k]+vertices[3*indices[3*t+1]+k]+vertices[3*indices[3*t+2]+k])/3.0;
+            double e=bbMax[k]-bbMin[k];
+            c[k]=0;
+            if (e>0.0)
+                c[k]=(unsigned int)std::min<double>(1023.0,(centroid-bbMin[k])/e*1024.0);
+        }
+        codes[t]=std::make_pair(mortonPart(c[0])|(mortonPart(c[1])<<1)|(mortonPart(c[2])<<2),int(t));
+    }
+    std::sort(codes.begin(),codes.end());
+    triangleOrder.resize(triCnt);
+    for (size_t t=0;t<triCnt;t++)
+        triangleOrder[t]=codes[t].second;
+}
+
+float forsythVertexScore(int cachePos,int remainingTriangles)
+{
+    const int cacheSize=32;
+    if (remainingTriangles==0)
+        return(-1.0f);
+    float score=0.0f;
+    if (cachePos>=0)
+    {
+        if (cachePos<3)
+            score=0.75f; // vertices of the last triangle: no preference, to avoid strips
+        else
+            score=powf(1.0f-float(cachePos-3)/float(cacheSize-3),1.5f);
+    }
+    score+=2.0f/sqrtf(float(remainingTriangles)); // favour vertices with few triangles left
+    return(score);
+}
+
+void optimizeVertexCache(const std::vector<int>& indices,size_t vertexCnt,std::vector<int>& triangleOrder)
+{ // triangleOrder is the initial order on input (used when restarting), the optimized order on output
+    const int cacheSize=32;
+    size_t triCnt=indices.size()/3;
+    std::vector<int> remaining(vertexCnt,0);
+    for (size_t i=0;i<indices.size();i++)
+        remaining[indices[i]]++;
+    std::vector<size_t> adjOffsets(vertexCnt+1,0);
+    for (size_t v=0;v<vertexCnt;v++)
+        adjOffsets[v+1]=adjOffsets[v]+remaining[v];
+    std::vector<int> adjacency(indices.size());
+    std::vector<size_t> fill(adjOffsets.begin(),adjOffsets.end()-1);
+    for (size_t t=0;t<triCnt;t++)
+    {
+        for (size_t k=0;k<3;k++)
+            adjacency[fill[indices[3*t+k]]++]=int(t);
+    }
+    std::vector<int> cachePos(vertexCnt,-1);
+    std::vector<float> vertexScores(vertexCnt);
+    for (size_t v=0;v<vertexCnt;v++)
+        vertexScores[v]=forsythVertexScore(-1,remaining[v]);
+    std::vector<float> triangleScores(triCnt);
+    for (size_t t=0;t<triCnt;t++)
+        triangleScores[t]=vertexScores[indices[3*t+0]]+vertexScores[indices[3*t+1]]+vertexScores[indices[3*t+2]];
+    std::vector<char> added(triCnt,0);
+    std::vector<int> cache;
+    std::vector<int> newCache;
+    std::vector<int> result;
+    result.reserve(triCnt);
+    size_t restart=0; // position in the initial order
+    int best=-1;
+    while (result.size()<triCnt)
+    {
+        if (best==-1)
+        { // nothing adjacent to the cache: continue with the next triangle in initial order
+            while (added[triangleOrder[restart]]!=0)
+                restart++;
+            best=triangleOrder[restart];
+        }
+        result.push_back(best);
+        added[best]=1;
+        newCache.clear();
+        for (size_t k=0;k<3;k++)
+        {
+            int v=indices[3*best+k];
+            newCache.push_back(v);
+            for (size_t a=adjOffsets[v];a<adjOffsets[v]+remaining[v];a++)
+            { // remove the triangle from the vertex's remaining triangles
+                if (adjacency[a]==best)
+                {
+                    adjacency[a]=adjacency[adjOffsets[v]+remaining[v]-1];
+                    break;
+                }
+            }
+            remaining[v]--;
+        }
+        for (size_t i=0;i<cache.size();i++)
+        {
+            int v=cache[i];
+            if ( (v!=newCache[0])&&(v!=newCache[1])&&(v!=newCache[2]) )
+                newCache.push_back(v);
+        }
+        for (size_t i=0;i<newCache.size();i++)
+        {
+            int v=newCache[i];
+            cachePos[v]=(i<size_t(cacheSize))?int(i):-1;
+            float s=forsythVertexScore(cachePos[v],remaining[v]);
+            float d=s-vertexScores[v];
+            vertexScores[v]=s;
+            for (size_t a=adjOffsets[v];a<adjOffsets[v]+remaining[v];a++)
+                triangleScores[adjacency[a]]+=d;
+        }
+        if (newCache.size()>size_t(cacheSize))
+            newCache.resize(cacheSize);
+        cache.swap(newCache);
+        best=-1;
+        float bestScore=-1.0f;
+        for (size_t i=0;i<cache.size();i++)
+        {
+            int v=cache[i];
+            for (size_t a=adjOffsets[v];a<adjOffsets[v]+remaining[v];a++)
+            {
+                int t=adjacency[a];
+                if (triangleScores[t]>bestScore)
+                {
+                    bestScore=triangleScores[t];
+                    best=t;
+                }
+            }
+        }
+    }
+    triangleOrder.swap(result);
+}
+
+struct SReorderStats
+{
+    double acmrBefore;
+    double acmrAfter;
+    size_t triangles;
+};
+
+SReorderStats reorderMesh(std::vector<double>& vertices,std::vector<int>& indices,std::vector<float>* textureCoords)
+{ // textureCoords, if not null nor empty, are 2 per index and follow their triangle
+    SReorderStats stats;
+    size_t vertexCnt=vertices.size()/3;
+    size_t triCnt=indices.size()/3;
+    stats.triangles=triCnt;
+    stats.acmrBefore=computeAcmr(indices,vertexCnt);
+    std::vector<int> triangleOrder;
+    sortTrianglesMorton(vertices,indices,triangleOrder);
+    optimizeVertexCache(indices,vertexCnt,triangleOrder);
+
+    std::vector<int> newIndices(indices.size());
+    for (size_t t=0;t<triCnt;t++)
+    {
+        for (size_t k=0;k<3;k++)
+            newIndices[3*t+k]=indices[3*triangleOrder[t]+k];
+    }
+    if ( (textureCoords!=nullptr)&&(textureCoords->size()==2*indices.size()) )
+    {
+        std::vector<float> newCoords(textureCoords->size());
+        for (size_t t=0;t<triCnt;t++)
+            memcpy(&newCoords[6*t],&textureCoords[0][6*triangleOrder[t]],6*sizeof(float));
+        textureCoords->swap(newCoords);
+    }
+
+    // vertices in order of first use. Unused vertices are dropped
+    std::vector<int> remap(vertexCnt,-1);
+    std::vector<double> newVertices;
+    newVertices.reserve(vertices.size());
+    for (size_t i=0;i<newIndices.size();i++)
+    {
+        int& r=remap[newIndices[i]];
+        if (r==-1)
+        {
+            r=int(newVertices.size()/3);
+            newVertices.insert(newVertices.end(),&vertices[3*newIndices[i]],&vertices[3*newIndices[i]]+3);
+        }
+        newIndices[i]=r;
+    }
+    vertices.swap(newVertices);
+    indices.swap(newIndices);
+    stats.acmrAfter=computeAcmr(indices,vertices.size()/3);
+    return(stats);
+}
+
+void reorderMeshes(std::vector<SImportMesh>& meshes,int options)
+{
+    std::vector<SReorderStats> stats(meshes.size());
+    parallelFor(meshes.size(),[&](size_t i)
+    {
+        stats[i]=reorderMesh(meshes[i].vertices,meshes[i].indices,&meshes[i].textureCoords);
+    });
+    if ((options&256)==0)
+    {
+        double before=0.0;
+        double after=0.0;
+        size_t triangles=0;
+        for (size_t i=0;i<stats.size();i++)
+        {
+            before+=stats[i].acmrBefore*double(stats[i].triangles);
+            after+=stats[i].acmrAfter*double(stats[i].triangles);
+            triangles+=stats[i].triangles;
+        }
+        if (triangles>0)
+        {
+            char txt[200];
+            snprintf(txt,sizeof(txt),"reordered %zu triangles for memory locality: vertex cache miss ratio (ACMR, 32-entry FIFO) %.3f --> %.3f",triangles,before/double(triangles),after/double(triangles));
+            converterLog(txt);
+        }
+    }
+}
+
+// Texture atlases: the textures of a file are packed into atlases of at most maxTextureSize x maxTextureSize
+// (shelf packing, with a few pixels of padding repeating the texture borders, against bleeding. Textures that do not
+// fit with their padding are packed halved), the texture
+// coordinates are remapped into the atlas regions, then meshes sharing an atlas and identical colors are merged.
+// Meshes with texture coordinates outside [0;1] (i.e. repeating textures) cannot use an atlas and are left as is.
+// Texture rows are kept in buffer order, i.e. row r of a texture maps to v=r/height, as for simCreateShape
+struct SAtlasPlacement
+{
+    int atlas;
+    int pos[2];
+};
+
+bool packTextures(const std::vector<const int*>& sizes,int atlasSize,int padding,std::vector<SAtlasPlacement>& placements,std::vector<std::array<int,2>>& atlasSizes)
+{ // shelf packing, tallest textures first. Returns false if a texture is too large
+    std::vector<size_t> order(sizes.size());
+    for (size_t i=0;i<order.size();i++)
+        order[i]=i;
+    std::sort(order.begin(),order.end(),[&](size_t a,size_t b){ return(sizes[a][1]>sizes[b][1]); });
+    placements.resize(sizes.size());
+    int shelfX=0;
+    int shelfY=0;
+    int shelfH=0;
+    for (size_t oi=0;oi<order.size();oi++)
+    {
+        size_t i=order[oi];
+        int w=sizes[i][0]+2*padding;
+        int h=sizes[i][1]+2*padding;
+        if ( (w>atlasSize)||(h>atlasSize) )
+            return(false);
+        if ( (atlasSizes.size()==0)||(shelfX+w>atlasSize) )
+        { // new shelf
+            shelfY+=shelfH;
+            shelfX=0;
+            shelfH=0;
+            if ( (atlasSizes.size()==0)||(shelfY+h>atlasSize) )
+            { // new atlas
+                atlasSizes.push_back({0,0});
+                shelfY=0;
+            }
+        }
+        placements[i].atlas=int(atlasSizes.size())-1;
+        placements[i].pos[0]=shelfX+padding;
+        placements[i].pos[1]=shelfY+padding;
+        shelfX+=w;
+        shelfH=std::max<int>(shelfH,h);
+        std::array<int,2>& as=atlasSizes.back();
+        as[0]=std::max<int>(as[0],shelfX);
+        as[1]=std::max<int>(as[1],shelfY+shelfH);
+    }
+    return(true);
+}
+
+void blitTexture(const unsigned char* img,const int* res,unsigned char* atlas,const int* atlasRes,const int* pos,int padding)
+{ // copies img into atlas at pos, and repeats its border pixels into the padding
+    for (int y=-padding;y<res[1]+padding;y++)
+    {
+        int sy=std::min<int>(std::max<int>(y,0),res[1]-1);
+        for (int x=-padding;x<res[0]+padding;x++)
+        {
+            int sx=std::min<int>(std::max<int>(x,0),res[0]-1);
+            memcpy(atlas+4*((pos[1]+y)*atlasRes[0]+pos[0]+x),img+4*(sy*res[0]+sx),4);
+        }
+    }
+}
+
+bool hasUnitTextureCoords(const SImportMesh& m)
+{
+    for (size_t i=0;i<m.textureCoords.size();i++)
+    {
+        if ( (m.textureCoords[i]<-0.001f)||(m.textureCoords[i]>1.001f) )
+            return(false);
+    }
+    return(m.textureCoords.size()>0);
+}
+
+void atlasMeshes(std::vector<SImportMesh>& meshes,std::vector<SImportTexture>& fileTextures,int maxTextureSize,int options)
+{ // the atlases are appended to fileTextures. Only decoded textures are packed
+    const int padding=2;
+    std::vector<const unsigned char*> textures;
+    std::vector<const int*> textureSizes;
+    std::map<int,size_t> textureIndices;
+    std::vector<int> meshTextures(meshes.size(),-1);
+    for (size_t i=0;i<meshes.size();i++)
+    {
+        SImportMesh& m=meshes[i];
+        if ( (m.texture>=0)&&(fileTextures[m.texture].image.size()>0)&&(m.tileGroup<0)&&hasUnitTextureCoords(m) )
+        {
+            std::map<int,size_t>::iterator it=textureIndices.find(m.texture);
+            if (it==textureIndices.end())
+            {
+                it=textureIndices.insert(std::make_pair(m.texture,textures.size())).first;
+                textures.push_back(fileTextures[m.texture].image.data());
+                textureSizes.push_back(fileTextures[m.texture].res);
+            }
+            meshTextures[i]=int(it->second);
+        }
+    }
+    if (textures.size()<2)
+        return; // nothing to gain
+    std::vector<SAtlasPlacement> placements;
+    std::vector<std::array<int,2>> atlasSizes;
+    std::vector<std::vector<unsigned char>> scaledTextures(textures.size()); // local copies, fileTextures stay untouched
+    std::vector<std::array<int,2>> scaledSizes(textures.size());
+    while (!packTextures(textureSizes,maxTextureSize,padding,placements,atlasSizes))
+    { // textures are at most maxTextureSize, but might not fit with their padding: halve those, so that atlases stay within maxTextureSize
+        atlasSizes.clear();
+        for (size_t i=0;i<textures.size();i++)
+        {
+            const int* res=textureSizes[i];
+            if ( (res[0]+2*padding<=maxTextureSize)&&(res[1]+2*padding<=maxTextureSize) )
+                continue;
+            if ( (res[0]==1)&&(res[1]==1) )
+                return; // maxTextureSize smaller than the padding
+            std::array<int,2> resOut={std::max<int>(1,res[0]/2),std::max<int>(1,res[1]/2)};
+            std::vector<unsigned char> img(4*size_t(resOut[0])*resOut[1]);
+            resampleImage(textures[i],res,4,img.data(),resOut.data(),resample_box);
+            scaledTextures[i].swap(img);
+            scaledSizes[i]=resOut;
+            textures[i]=scaledTextures[i].data();
+            textureSizes[i]=scaledSizes[i].data();
+        }
+    }
+
+    std::vector<SImportTexture> atlases(atlasSizes.size());
+    for (size_t a=0;a<atlasSizes.size();a++)
+    {
+        atlases[a].key="#atlas"+std::to_string(a);
+        atlases[a].res[0]=atlasSizes[a][0];
+        atlases[a].res[1]=atlasSizes[a][1];
+        atlases[a].image.assign(4*size_t(atlasSizes[a][0])*atlasSizes[a][1],0);
+    }
+    parallelFor(textures.size(),[&](size_t i)
+    { // placements do not overlap
+        SImportTexture& atlas=atlases[placements[i].atlas];
+        blitTexture(textures[i],textureSizes[i],atlas.image.data(),atlas.res,placements[i].pos,padding);
+    });
+    parallelFor(meshes.size(),[&](size_t i)
+    {
+        if (meshTextures[i]<0)
+            return;
+        SImportMesh& m=meshes[i];
+        const SAtlasPlacement& p=placements[meshTextures[i]];
+        const int* res=textureSizes[meshTextures[i]];
+        const int* atlasRes=atlases[p.atlas].res;
+        for (size_t j=0;j<m.textureCoords.size()/2;j++)
+        {
+            float u=std::min<float>(std::max<float>(m.textureCoords[2*j+0],0.0f),1.0f);
+            float v=std::min<float>(std::max<float>(m.textureCoords[2*j+1],0.0f),1.0f);
+            m.textureCoords[2*j+0]=(float(p.pos[0])+u*float(res[0]))/float(atlasRes[0]);
+            m.textureCoords[2*j+1]=(float(p.pos[1])+v*float(res[1]))/float(atlasRes[1]);
+        }
+    });
+
+    // Merge the meshes of a same atlas with identical colors
+    std::vector<SImportMesh> result;
+    std::map<std::vector<float>,size_t> mergedMeshes;
+    size_t mergeCnt=0;
+    for (size_t i=0;i<meshes.size();i++)
+    {
+        SImportMesh& m=meshes[i];
+        if (meshTextures[i]<0)
+        {
+            result.push_back(std::move(m));
+            continue;
+        }
+        int atlas=placements[meshTextures[i]].atlas;
+        std::vector<float> key(1,float(atlas));
+        key.insert(key.end(),m.colorAD,m.colorAD+3);
+        key.insert(key.end(),m.colorS,m.colorS+3);
+        key.insert(key.end(),m.colorE,m.colorE+3);
+        key.push_back(m.transparency);
+        std::map<std::vector<float>,size_t>::iterator it=mergedMeshes.find(key);
+        if (it==mergedMeshes.end())
+        {
+            m.texture=int(fileTextures.size())+atlas;
+            mergedMeshes[key]=result.size();
+            result.push_back(std::move(m));
+        }
+        else
+        {
+            SImportMesh& dest=result[it->second];
+            int offset=int(dest.vertices.size()/3);
+            dest.vertices.insert(dest.vertices.end(),m.vertices.begin(),m.vertices.end());
+            for (size_t j=0;j<m.indices.size();j++)
+                dest.indices.push_back(m.indices[j]+offset);
+            dest.textureCoords.insert(dest.textureCoords.end(),m.textureCoords.begin(),m.textureCoords.end());
+            mergeCnt++;
+        }
+    }
+    meshes.swap(result);
+    fileTextures.insert(fileTextures.end(),std::make_move_iterator(atlases.begin()),std::make_move_iterator(atlases.end()));
+    if ((options&256)==0)
+    {
+        std::string txt("packed "+std::to_string(textures.size())+" textures into "+std::to_string(atlasSizes.size())+" atlas(es), "+std::to_string(mergeCnt)+" meshes merged");
+        converterLog(txt);
+    }
+}
+
+void jacobiEigen(const double* sym,double* eigenVectors)
+{ // eigenvectors of a symmetric 3x3 matrix (row-major), as columns of eigenVectors (row-major)
+    double a[9];
+    memcpy(a,sym,sizeof(a));
+    for (size_t i=0;i<9;i++)
+        eigenVectors[i]=((i%4)==0)?1.0:0.0;
+    for (int sweep=0;sweep<50;sweep++)
+    {
+        double off=fabs(a[1])+fabs(a[2])+fabs(a[5]);
+        if (off<1e-15*(fabs(a[0])+fabs(a[4])+fabs(a[8])+1e-300))
+            break;
+        for (int p=0;p<2;p++)
+        {
+            for (int q=p+1;q<3;q++)
+            {
+                double apq=a[3*p+q];
+                if (fabs(apq)<1e-300)
+                    continue;
+                double theta=0.5*(a[3*q+q]-a[3*p+p])/apq;
+                double t=((theta>=0.0)?1.0:-1.0)/(fabs(theta)+sqrt(theta*theta+1.0));
+                double c=1.0/sqrt(t*t+1.0);
+                double s=t*c;
+                for (int k=0;k<3;k++)
+                { // a=J^T*a*J
+                    double akp=a[3*k+p];
+                    double akq=a[3*k+q];
+                    a[3*k+p]=c*akp-s*akq;
+                    a[3*k+q]=s*akp+c*akq;
+                }
+                for (int k=0;k<3;k++)
+                {
+                    double apk=a[3*p+k];
+                    double aqk=a[3*q+k];
+                    a[3*p+k]=c*apk-s*aqk;
+                    a[3*q+k]=s*apk+c*aqk;
+                }
+                for (int k=0;k<3;k++)
+                {
+                    double vkp=eigenVectors[3*k+p];
+                    double vkq=eigenVectors[3*k+q];
+                    eigenVectors[3*k+p]=c*vkp-s*vkq;
+                    eigenVectors[3*k+q]=s*vkp+c*vkq;
+                }
+            }
+        }
+    }
+}
+
+void convexHull2d(std::vector<std::array<double,2>>& points,std::vector<std::array<double,2>>& hull)
+{ // counter-clockwise, without collinear points (Andrew's monotone chain). points gets sorted
+    std::sort(points.begin(),points.end());
+    points.erase(std::unique(points.begin(),points.end()),points.end());
+    hull.clear();
+    if (points.size()<3)
+    {
+        hull=points;
+        return;
+    }
+    hull.resize(2*points.size());
+    size_t k=0;
+    for (int pass=0;pass<2;pass++)
+    { // lower, then upper chain
+        size_t start=k;
+        for (size_t n=0;n<points.size();n++)
+        {
+            const std::array<double,2>& pt=points[(pass==0)?n:points.size()-1-n];
+            while (k>=start+2)
+            {
+                const std::array<double,2>& a=hull[k-2];
+                const std::array<double,2>& b=hull[k-1];
+                if ((b[0]-a[0])*(pt[1]-a[1])-(b[1]-a[1])*(pt[0]-a[0])>0.0)
+                    break;
+                k--;
+            }
+            hull[k++]=pt;
+        }
+        k--; // last point is the first of the other chain
+    }
+    hull.resize(k);
+}
+
+double minAreaRectangle(const std::vector<std::array<double,2>>& hull,double* direction)
+{ // rotating calipers: the minimum-area enclosing rectangle has a side on a hull edge. direction receives that side's direction
+    direction[0]=1.0;
+    direction[1]=0.0;
+    size_t n=hull.size();
+    if (n<3)
+        return(0.0);
+    double bestArea=DBL_MAX;
+    size_t maxE=0,minE=0,maxN=0; // caliper vertices: extremes along the edge, and farthest from it
+    for (size_t i=0;i<n;i++)
+    {
+        const std::array<double,2>& a=hull[i];
+        const std::array<double,2>& b=hull[(i+1)%n];
+        double e[2]={b[0]-a[0],b[1]-a[1]};
+        double l=sqrt(e[0]*e[0]+e[1]*e[1]);
+        if (l==0.0)
+            continue;
+        e[0]/=l;
+        e[1]/=l;
+        double nrm[2]={-e[1],e[0]}; // points inside, since the hull is counter-clockwise
+        auto dot=[&](size_t j,const double* d){ return(hull[j%n][0]*d[0]+hull[j%n][1]*d[1]); };
+        double me[2]={-e[0],-e[1]};
+        if (i==0)
+        {
+            for (size_t j=1;j<n;j++)
+            {
+                if (dot(j,e)>dot(maxE,e))
+                    maxE=j;
+                if (dot(j,e)<dot(minE,e))
+                    minE=j;
+                if (dot(j,nrm)>dot(maxN,nrm))
+                    maxN=j;
+            }
+        }
+        else
+        { // the extremes only move forward around the hull
+            while (dot(maxE+1,e)>dot(maxE,e))
+                maxE=(maxE+1)%n;
+            while (dot(maxN+1,nrm)>dot(maxN,nrm))
+                maxN=(maxN+1)%n;
+            while (dot(minE+1,me)>dot(minE,me))
+                minE=(minE+1)%n;
+        }
+        double area=(dot(maxE,e)-dot(minE,e))*(dot(maxN,nrm)-dot(i,nrm));
+        if (area<bestArea)
+        {
+            bestArea=area;
+            direction[0]=e[0];
+            direction[1]=e[1];
+        }
+    }
+    return(bestArea);
+}
+
+void boxExtents(const double* vertices,size_t vertexCnt,const double* axes,double* minV,double* maxV)
+{
+    for (size_t k=0;k<3;k++)
+    {
+        minV[k]=DBL_MAX;
+        maxV[k]=-DBL_MAX;
+    }
+    for (size_t i=0;i<vertexCnt;i++)
+    {
+        const double* v=vertices+3*i;
+        for (size_t k=0;k<3;k++)
+        {
+            double d=v[0]*axes[3*k+0]+v[1]*axes[3*k+1]+v[2]*axes[3*k+2];
+            minV[k]=std::min<double>(minV[k],d);
+            maxV[k]=std::max<double>(maxV[k],d);
+        }
+    }
+}
+
+void computeMeshFrame(const double* vertices,size_t vertexCnt,bool minVolume,SMeshFrame& frame)
+{
+    double axes[9]={1.0,0.0,0.0,0.0,1.0,0.0,0.0,0.0,1.0};
+    if ( minVolume&&(vertexCnt>=3) )
+    {
+        double mean[3]={0.0,0.0,0.0};
+        for (size_t i=0;i<vertexCnt;i++)
+        {
+            for (size_t k=0;k<3;k++)
+                mean[k]+=vertices[3*i+k];
+        }
+        for (size_t k=0;k<3;k++)
+            mean[k]/=double(vertexCnt);
+        double cov[9]={0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0};
+        for (size_t i=0;i<vertexCnt;i++)
+        {
+            double d[3]={vertices[3*i+0]-mean[0],vertices[3*i+1]-mean[1],vertices[3*i+2]-mean[2]};
+            for (size_t r=0;r<3;r++)
+            {
+                for (size_t c=0;c<3;c++)
+                    cov[3*r+c]+=d[r]*d[c];
+            }
+        }
+        double ev[9];
+        jacobiEigen(cov,ev);
+        double pca[9]; // rows are the principal axes
+        for (size_t k=0;k<3;k++)
+        {
+            for (size_t j=0;j<3;j++)
+                pca[3*k+j]=ev[3*j+k];
+        }
+        double minV[3],maxV[3];
+        boxExtents(vertices,vertexCnt,pca,minV,maxV);
+        double ext[3]={maxV[0]-minV[0],maxV[1]-minV[1],maxV[2]-minV[2]};
+        // candidates are compared by volume, then, for near-equal volumes (e.g. 0 for planar meshes), by the area
+        // spanned by their two largest extents
+        double volumeTolerance=1e-9*pow(std::max<double>(ext[0],std::max<double>(ext[1],ext[2])),3);
+        auto largestArea=[](const double* e)
+        {
+            double s[3]={e[0],e[1],e[2]};
+            std::sort(s,s+3);
+            return(s[1]*s[2]);
+        };
+        double bestVolume=ext[0]*ext[1]*ext[2];
+        double bestArea=largestArea(ext);
+        memcpy(axes,pca,sizeof(axes));
+        std::vector<std::array<double,2>> points(vertexCnt);
+        std::vector<std::array<double,2>> hull;
+        for (size_t k=0;k<3;k++)
+        { // keep principal axis k, and find the best rotation around it
+            const double* a=pca+3*((k+1)%3);
+            const double* b=pca+3*((k+2)%3);
+            for (size_t i=0;i<vertexCnt;i++)
+            {
+                const double* v=vertices+3*i;
+                points[i][0]=v[0]*a[0]+v[1]*a[1]+v[2]*a[2];
+                points[i][1]=v[0]*b[0]+v[1]*b[1]+v[2]*b[2];
+            }
+            convexHull2d(points,hull);
+            double dir[2];
+            minAreaRectangle(hull,dir);
+            double cand[9];
+            for (size_t j=0;j<3;j++)
+            {
+                cand[3*0+j]=pca[3*k+j];
+                cand[3*1+j]=dir[0]*a[j]+dir[1]*b[j];
+                cand[3*2+j]=-dir[1]*a[j]+dir[0]*b[j];
+            }
+            double cMin[3],cMax[3];
+            boxExtents(vertices,vertexCnt,cand,cMin,cMax);
+            double cExt[3]={cMax[0]-cMin[0],cMax[1]-cMin[1],cMax[2]-cMin[2]};
+            double volume=cExt[0]*cExt[1]*cExt[2];
+            double area=largestArea(cExt);
+            if ( (volume<bestVolume-volumeTolerance)||((volume<=bestVolume+volumeTolerance)&&(area<bestArea)) )
+            {
+                bestVolume=volume;
+                bestArea=area;
+                memcpy(axes,cand,sizeof(axes));
+            }
+        }
+        // right-handed: z=x^y
+        axes[6]=axes[1]*axes[5]-axes[2]*axes[4];
+        axes[7]=axes[2]*axes[3]-axes[0]*axes[5];
+        axes[8]=axes[0]*axes[4]-axes[1]*axes[3];
+    }
+    double minV[3]={0.0,0.0,0.0};
+    double maxV[3]={0.0,0.0,0.0};
+    if (vertexCnt>0)
+        boxExtents(vertices,vertexCnt,axes,minV,maxV);
+    for (size_t j=0;j<3;j++)
+    {
+        frame.position[j]=0.0;
+        for (size_t k=0;k<3;k++)
+            frame.position[j]+=0.5*(minV[k]+maxV[k])*axes[3*k+j];
+    }
+    for (size_t k=0;k<3;k++)
+        frame.halfSizes[k]=0.5*(maxV[k]-minV[k]);
+    memcpy(frame.axes,axes,sizeof(axes));
+}
+
+void frameMeshes(std::vector<SImportMesh>& meshes,bool minVolume,std::vector<SMeshFrame>& frames)
+{
+    frames.resize(meshes.size());
+    parallelFor(meshes.size(),[&](size_t i)
+    {
+        std::vector<double>& v=meshes[i].vertices;
+        SMeshFrame& f=frames[i];
+        computeMeshFrame(v.data(),v.size()/3,minVolume,f);
+        for (size_t j=0;j<v.size()/3;j++)
+        {
+            double d[3]={v[3*j+0]-f.position[0],v[3*j+1]-f.position[1],v[3*j+2]-f.position[2]};
+            for (size_t k=0;k<3;k++)
+                v[3*j+k]=d[0]*f.axes[3*k+0]+d[1]*f.axes[3*k+1]+d[2]*f.axes[3*k+2];
+        }
+    });
+}
+
+void processMeshes(std::vector<SImportMesh>& meshes,std::vector<SImportTexture>& textures,int maxTextureSize,int options,int maxTileTriangles,double weldTolerance)
+{
+    if (weldTolerance>0.0)
+        weldMeshes(meshes,weldTolerance,options);
+
+    if ( ((options&2048)!=0)&&((options&1)==0) )
+        atlasMeshes(meshes,textures,maxTextureSize,options);
+
+    if (maxTileTriangles>0)
+        tileMeshes(meshes,maxTileTriangles);
+
+    if ((options&1024)!=0)
+        reorderMeshes(meshes,options);
+}
+
+// Mesh cache layout: "SIMMESH", version byte, flags (1=has materials), texture count, mesh count, then
+// for each texture: res, RGBA image (possibly empty), compressed data (possibly empty), format hint,
+// for each mesh: alias, colors, transparency, tile group, texture index, vertices, indices, texture coordinates.
+// Counts are uint32, vertices and texture coordinates float32, indices int32. Only referenced textures are written
+const char* meshCacheExtension="simmesh";
+static const char meshCacheMagic[8]={'S','I','M','M','E','S','H',1};
+
+struct SCacheWriter
+{
+    std::string data;
+    template<typename T>
+    void add(const T* v,size_t cnt)
+    {
+        data.append((const char*)v,cnt*sizeof(T));
+    }
+    void addCount(size_t cnt)
+    {
+        uint32_t c=uint32_t(cnt);
+        add(&c,1);
+    }
+    void addString(const std::string& str)
+    {
+        addCount(str.size());
+        add(str.data(),str.size());
+    }
+};
+
+struct SCacheReader
+{
+    const char* data;
+    size_t size;
+    size_t pos;
+    template<typename T>
+    bool get(T* v,size_t cnt)
+    {
+        if (cnt>(size-pos)/sizeof(T))
+            return(false);
+        memcpy(v,data+pos,cnt*sizeof(T));
+        pos+=cnt*sizeof(T);
+        return(true);
+    }
+    bool getCount(size_t& cnt)
+    {
+        uint32_t c;
+        if (!get(&c,1))
+            return(false);
+        cnt=c;
+        return(true);
+    }
+    bool getString(std::string& str)
+    {
+        size_t l;
+        if ( (!getCount(l))||(l>size-pos) )
+            return(false);
+        str.assign(data+pos,l);
+        pos+=l;
+        return(true);
+    }
+};
+
+bool writeMeshCache(const std::string& filename,const std::vector<SImportMesh>& meshes,const std::vector<SImportTexture>& textures,bool hasMaterials)
+{
+    std::vector<int> newTextureIndices(textures.size(),-1);
+    std::vector<size_t> usedTextures;
+    for (size_t i=0;i<meshes.size();i++)
+    {
+        int t=meshes[i].texture;
+        if ( (t>=0)&&(textures[t].image.size()==0)&&(textures[t].data.size()==0) )
+            continue; // e.g. a missing texture file: the mesh is stored untextured
+        if ( (t>=0)&&(newTextureIndices[t]<0) )
+        {
+            newTextureIndices[t]=int(usedTextures.size());
+            usedTextures.push_back(size_t(t));
+        }
+    }
+    SCacheWriter w;
+    w.add(meshCacheMagic,8);
+    w.addCount(hasMaterials?1:0);
+    w.addCount(usedTextures.size());
+    w.addCount(meshes.size());
+    for (size_t i=0;i<usedTextures.size();i++)
+    {
+        const SImportTexture& t=textures[usedTextures[i]];
+        w.add(t.res,2);
+        w.addCount(t.image.size());
+        w.add(t.image.data(),t.image.size());
+        w.addString(t.data);
+        w.addString(t.formatHint);
+    }
+    std::vector<float> buff;
+    for (size_t i=0;i<meshes.size();i++)
+    {
+        const SImportMesh& m=meshes[i];
+        w.addString(m.alias);
+        w.add(m.colorAD,3);
+        w.add(m.colorS,3);
+        w.add(m.colorE,3);
+        w.add(&m.transparency,1);
+        w.add(&m.tileGroup,1);
+        int t=(m.texture>=0)?newTextureIndices[m.texture]:-1;
+        w.add(&t,1);
+        buff.assign(m.vertices.begin(),m.vertices.end());
+        w.addCount(buff.size());
+        w.add(buff.data(),buff.size());
+        w.addCount(m.indices.size());
+        w.add(m.indices.data(),m.indices.size());
+        w.addCount(m.textureCoords.size());
+        w.add(m.textureCoords.data(),m.textureCoords.size());
+    }
+    std::ofstream f(std::filesystem::u8path(filename),std::ios::binary|std::ios::trunc);
+    f.write(w.data.data(),std::streamsize(w.data.size()));
+    return(f.good());
+}
+
+bool readMeshCache(const char* data,size_t size,std::vector<SImportMesh>& meshes,std::vector<SImportTexture>& textures,bool& hasMaterials)
+{
+    SCacheReader r;
+    r.data=data;
+    r.size=size;
+    r.pos=0;
+    char magic[8];
+    size_t flags,textureCnt,meshCnt;
+    if ( (!r.get(magic,8))||(memcmp(magic,meshCacheMagic,8)!=0) )
+        return(false);
+    if ( (!r.getCount(flags))||(!r.getCount(textureCnt))||(!r.getCount(meshCnt)) )
+        return(false);
+    hasMaterials=((flags&1)!=0);
+    size_t firstTexture=textures.size();
+    for (size_t i=0;i<textureCnt;i++)
+    {
+        SImportTexture t;
+        size_t l;
+        if ( (!r.get(t.res,2))||(!r.getCount(l))||(l>size-r.pos) )
+            return(false);
+        t.image.resize(l);
+        if ( (!r.get(t.image.data(),l))||(!r.getString(t.data))||(!r.getString(t.formatHint)) )
+            return(false);
+        if (l==0)
+        { // compressed only (res is set when decoded), but not empty
+            if (t.data.size()==0)
+                return(false);
+        }
+        else if ( (t.res[0]<=0)||(t.res[1]<=0)||(l!=4*size_t(t.res[0])*size_t(t.res[1])) )
+            return(false);
+        t.key="*"+std::to_string(i);
+        textures.push_back(std::move(t));
+    }
+    std::vector<float> buff;
+    for (size_t i=0;i<meshCnt;i++)
+    {
+        SImportMesh m;
+        size_t l;
+        if ( (!r.getString(m.alias))||(!r.get(m.colorAD,3))||(!r.get(m.colorS,3))||(!r.get(m.colorE,3))||(!r.get(&m.transparency,1))||(!r.get(&m.tileGroup,1))||(!r.get(&m.texture,1)) )
+            return(false);
+        if ( (!r.getCount(l))||(l>(size-r.pos)/sizeof(float)) )
+            return(false);
+        buff.resize(l);
+        r.get(buff.data(),l);
+        m.vertices.assign(buff.begin(),buff.end());
+        if ( (!r.getCount(l))||(l>(size-r.pos)/sizeof(int)) )
+            return(false);
+        m.indices.resize(l);
+        r.get(m.indices.data(),l);
+        if ( (!r.getCount(l))||(l>(size-r.pos)/sizeof(float)) )
+            return(false);
+        m.textureCoords.resize(l);
+        r.get(m.textureCoords.data(),l);
+        if ( (m.vertices.size()%3!=0)||(m.indices.size()%3!=0) )
+            return(false);
+        if ( (m.textureCoords.size()!=0)&&(m.textureCoords.size()!=2*m.indices.size()) )
+            return(false);
+        if ( (m.texture>=int(textureCnt))||(m.texture<-1) )
+            return(false);
+        if (m.texture>=0)
+            m.texture+=int(firstTexture);
+        for (size_t j=0;j<m.indices.size();j++)
+        {
+            if ( (m.indices[j]<0)||(size_t(m.indices[j])>=m.vertices.size()/3) )
+                return(false);
+        }
+        meshes.push_back(std::move(m));
+    }
+    return(true);
+}
+
+bool isMeshCache(const SImportSource& source)
+{
+    if (source.buffer!=nullptr)
+        return(source.formatHint==meshCacheExtension);
+    return(normalizeExtension(std::filesystem::u8path(source.filename).extension().string())==meshCacheExtension);
+}
+
+bool loadMeshCache(const SImportSource& source,std::vector<SImportMesh>& meshes,std::vector<SImportTexture>& textures,bool& hasMaterials)
+{
+    if (source.buffer!=nullptr)
+        return(readMeshCache(source.buffer,source.bufferSize,meshes,textures,hasMaterials));
+    SMappedFile f;
+    if (!f.map(source.filename))
+        return(false);
+    return(readMeshCache(f.data,f.size,meshes,textures,hasMaterials));
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+
+// The Assimp-to-mesh conversion core: reading files, flattening, scaling and orienting their meshes, and the mesh
+// post-processing steps (welding, texture atlases, tiling, reordering). It does not call the sim API, and is shared
+// by the plugin and by the standalone simAssimpConverter tool, which pre-bakes files into mesh caches (see below)
+
+// Provided by the host (plugin.cpp, or converter.cpp). Must be thread-safe
+void converterLog(const std::string& txt);
+
+// Set on parallelFor's worker threads: a nested parallelFor then runs serially, instead of oversubscribing the cores
+inline bool& inParallelFor()
+{
+    thread_local bool inside=false;
+    return(inside);
+}
+
+template<typename F>
+void parallelFor(size_t cnt,F f)
+{ // runs f(0)..f(cnt-1) on all cores. f must not call the sim API
+    size_t threadCnt=std::min<size_t>(cnt,std::max<size_t>(1,std::thread::hardware_concurrency()));
+    if ( (threadCnt<=1)||inParallelFor() )
+    {
+        for (size_t i=0;i<cnt;i++)
+            f(i);
+        return;
+    }
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    std::vector<std::thread> threads;
+    for (size_t t=0;t<threadCnt;t++)
+    {
+        threads.emplace_back([&]()
+        {
+            inParallelFor()=true;
+            size_t i;
+            while ((i=next++)<cnt)
+            {
+                try
+                {
+                    f(i);
+                }
+                catch(...)
+                {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error)
+                        error=std::current_exception();
+                }
+            }
+        });
+    }
+    for (size_t t=0;t<threads.size();t++)
+        threads[t].join();
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void splitString(const std::string& str,char delChar,std::vector<std::string>& words);
+std::string toLowerCase(std::string str);
+std::string normalizeExtension(const std::string& ext);
+
+// Importers are expensive to construct (they instantiate all format handlers), so they are pooled for the
+// process' lifetime. A pooled importer returns to its pool when released:
+struct SImporterRecycler
+{
+    void operator()(Assimp::Importer* importer) const;
+};
+typedef std::unique_ptr<Assimp::Importer,SImporterRecycler> PooledImporter;
+
+PooledImporter acquireImporter();
+void clearImporterPool();
+int prepareImporter(Assimp::Importer& importer,int& options);
+
+struct SImportSource
+{ // a file, or a memory buffer
+    std::string filename; // empty for a memory buffer
+    const char* buffer;
+    size_t bufferSize;
+    std::string formatHint; // file extension, for a memory buffer
+    std::string name; // for logs and shape aliases
+};
+
+std::vector<SImportSource> getFileSources(const char* fileNames);
+std::vector<SImportSource> getBufferSource(const char* buffer,size_t bufferSize,const char* formatHint);
+const aiScene* readScene(Assimp::Importer& importer,const SImportSource& source,int flags);
+std::string getSourceAlias(const SImportSource& source);
+void transformVertices(const aiScene* scene,double& scaling,int& upVector,double* boundingBox=nullptr);
+
+struct SImportTexture
+{ // a texture, decoded, or still compressed as found in the file (decoding image formats is left to the host)
+    std::string key; // "*index" for embedded textures, otherwise the texture's file path
+    std::string filename; // an external texture whose content was not read yet, or empty
+    std::string data; // compressed image (e.g. png or jpg), or empty
+    std::string formatHint;
+    std::vector<unsigned char> image; // RGBA, empty until decoded
+    int res[2];
+};
+
+struct SImportMesh
+{ // a shape to be created
+    std::string alias;
+    std::vector<double> vertices;
+    std::vector<int> indices;
+    std::vector<float> textureCoords; // 2 per index, or empty
+    int texture; // index in the file's textures, or -1
+    float colorAD[3];
+    float colorS[3];
+    float colorE[3];
+    float transparency;
+    int tileGroup; // index of the mesh this tile was cut from, or -1
+};
+
+// Fills meshes and textures from a scene that went through transformVertices. Returns whether the file has materials
+bool extractMeshes(const aiScene* scene,const SImportSource& source,Assimp::IOSystem* io,double scaling,int upVector,int options,std::vector<SImportMesh>& meshes,std::vector<SImportTexture>& textures);
+bool readTextureFile(SImportTexture& texture);
+bool scaleTexture(const unsigned char* img,const int* res,int maxSize,int textureScaling,std::vector<unsigned char>& out,int* resOut);
+
+struct SWeldCell
+{ // a cell of a uniform grid
+    long long c[3];
+    bool operator==(const SWeldCell& o) const { return( (c[0]==o.c[0])&&(c[1]==o.c[1])&&(c[2]==o.c[2]) ); }
+};
+struct SWeldCellHash
+{
+    size_t operator()(const SWeldCell& k) const { return(size_t(k.c[0]*73856093LL)^size_t(k.c[1]*19349663LL)^size_t(k.c[2]*83492791LL)); }
+};
+struct SWeldStats
+{
+    size_t removedVertices;
+    size_t removedTriangles;
+};
+SWeldStats weldMesh(std::vector<double>& vertices,std::vector<int>& indices,std::vector<float>* textureCoords,double tolerance,std::vector<int>* vertexOrigins=nullptr);
+SWeldStats weldMesh(aiMesh* mesh,double tolerance);
+void logWeldStats(const std::vector<SWeldStats>& stats);
+void weldMeshes(std::vector<SImportMesh>& meshes,double tolerance,int options);
+void atlasMeshes(std::vector<SImportMesh>& meshes,std::vector<SImportTexture>& textures,int maxTextureSize,int options);
+void tileMeshes(std::vector<SImportMesh>& meshes,int maxTriangles);
+void reorderMeshes(std::vector<SImportMesh>& meshes,int options);
+
+// Shape frames: the vertices of a mesh can be expressed in a frame of its own, so that the shape is created with that
+// frame directly, instead of being realigned afterwards by the simulator
+struct SMeshFrame
+{
+    double position[3]; // center of the bounding box, in the file frame
+    double axes[9]; // x, y and z axes of the frame, in the file frame. Right-handed
+    double halfSizes[3]; // of the bounding box along the axes
+};
+// The frame of an axis-aligned box (minVolume false), or of a minimum-volume box (principal axes, refined with
+// minimum-area rectangles of the convex hull projected along each of them. Planar meshes, whose volumes are all 0, get
+// the box with the smallest face)
+void computeMeshFrame(const double* vertices,size_t vertexCnt,bool minVolume,SMeshFrame& frame);
+// Computes the frames of the meshes in parallel, and expresses the vertices in them
+void frameMeshes(std::vector<SImportMesh>& meshes,bool minVolume,std::vector<SMeshFrame>& frames);
+
+// Welding, atlases (decoded textures only), tiling and reordering, as selected by the import arguments
+void processMeshes(std::vector<SImportMesh>& meshes,std::vector<SImportTexture>& textures,int maxTextureSize,int options,int maxTileTriangles,double weldTolerance);
+
+// Mesh caches (*.simmesh) hold the processed meshes of one file, with scaling and up-vector applied, and textures
+// kept compressed. Loading one is mostly a few memcpy's. Data is in the host's byte order
+extern const char* meshCacheExtension;
+bool writeMeshCache(const std::string& filename,const std::vector<SImportMesh>& meshes,const std::vector<SImportTexture>& textures,bool hasMaterials);
+bool readMeshCache(const char* data,size_t size,std::vector<SImportMesh>& meshes,std::vector<SImportTexture>& textures,bool& hasMaterials);
+bool isMeshCache(const SImportSource& source);
+bool loadMeshCache(const SImportSource& source,std::vector<SImportMesh>& meshes,std::vector<SImportTexture>& textures,bool& hasMaterials);
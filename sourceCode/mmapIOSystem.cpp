@@ -0,0 +1,231 @@
+#include "mmapIOSystem.h"
+#include <cstring>
+#include <mutex>
+#include <filesystem>
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+SMappedFile::SMappedFile()
+{
+    data=nullptr;
+    size=0;
+#ifdef _WIN32
+    fileHandle=INVALID_HANDLE_VALUE;
+    mappingHandle=nullptr;
+#else
+    fd=-1;
+#endif
+}
+
+SMappedFile::~SMappedFile()
+{
+#ifdef _WIN32
+    if (data!=nullptr)
+        UnmapViewOfFile(data);
+    if (mappingHandle!=nullptr)
+        CloseHandle(mappingHandle);
+    if (fileHandle!=INVALID_HANDLE_VALUE)
+        CloseHandle(fileHandle);
+#else
+    if (data!=nullptr)
+        munmap((void*)data,size);
+    if (fd!=-1)
+        close(fd);
+#endif
+}
+
+bool SMappedFile::map(const std::string& filename)
+{
+#ifdef _WIN32
+    std::filesystem::path p=std::filesystem::u8path(filename);
+    fileHandle=CreateFileW(p.c_str(),GENERIC_READ,FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,nullptr,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL|FILE_FLAG_SEQUENTIAL_SCAN,nullptr);
+    if (fileHandle==INVALID_HANDLE_VALUE)
+        return(false);
+    LARGE_INTEGER s;
+    if (GetFileSizeEx(fileHandle,&s)==0)
+        return(false);
+    size=size_t(s.QuadPart);
+    if (size==0)
+        return(true); // empty files cannot be mapped
+    mappingHandle=CreateFileMappingW(fileHandle,nullptr,PAGE_READONLY,0,0,nullptr);
+    if (mappingHandle==nullptr)
+        return(false);
+    data=(const char*)MapViewOfFile(mappingHandle,FILE_MAP_READ,0,0,0);
+    return(data!=nullptr);
+#else
+    fd=open(filename.c_str(),O_RDONLY);
+    if (fd==-1)
+        return(false);
+    struct stat s;
+    if ( (fstat(fd,&s)!=0)||(!S_ISREG(s.st_mode)) )
+        return(false);
+    size=size_t(s.st_size);
+    if (size==0)
+        return(true); // empty files cannot be mapped
+    void* p=mmap(nullptr,size,PROT_READ,MAP_PRIVATE,fd,0);
+    if (p==MAP_FAILED)
+        return(false);
+    data=(const char*)p;
+    madvise(p,size,MADV_SEQUENTIAL); // parsers mostly read front to back
+    madvise(p,size,MADV_WILLNEED);
+    return(true);
+#endif
+}
+
+CMMapIOStream::CMMapIOStream(const std::shared_ptr<SMappedFile>& file)
+{
+    _file=file;
+    _position=0;
+}
+
+CMMapIOStream::~CMMapIOStream()
+{
+}
+
+size_t CMMapIOStream::Read(void* pvBuffer,size_t pSize,size_t pCount)
+{
+    if ( (pSize==0)||(pCount==0) )
+        return(0);
+    size_t cnt=(_file->size-_position)/pSize;
+    if (cnt>pCount)
+        cnt=pCount;
+    memcpy(pvBuffer,_file->data+_position,cnt*pSize);
+    _position+=cnt*pSize;
+    return(cnt);
+}
+
+size_t CMMapIOStream::Write(const void* /*pvBuffer*/,size_t /*pSize*/,size_t /*pCount*/)
+{ // read-only
+    return(0);
+}
+
+aiReturn CMMapIOStream::Seek(size_t pOffset,aiOrigin pOrigin)
+{
+    size_t p;
+    if (pOrigin==aiOrigin_SET)
+        p=pOffset;
+    else if (pOrigin==aiOrigin_CUR)
+        p=_position+pOffset;
+    else if (pOrigin==aiOrigin_END)
+        p=_file->size-pOffset;
+    else
+        return(aiReturn_FAILURE);
+    if (p>_file->size)
+        return(aiReturn_FAILURE);
+    _position=p;
+    return(aiReturn_SUCCESS);
+}
+
+size_t CMMapIOStream::Tell() const
+{
+    return(_position);
+}
+
+size_t CMMapIOStream::FileSize() const
+{
+    return(_file->size);
+}
+
+void CMMapIOStream::Flush()
+{
+}
+
+// Files currently open by any importer. Lets parallel imports of the same file, or a texture/buffer file
+// referenced several times, share one mapping. Entries expire when the last stream closes
+static std::mutex mappedFilesMutex;
+static std::unordered_map<std::string,std::weak_ptr<SMappedFile>> mappedFiles;
+
+static std::shared_ptr<SMappedFile> openMappedFile(const std::string& filename,size_t expectedSize)
+{
+    std::lock_guard<std::mutex> lock(mappedFilesMutex);
+    std::unordered_map<std::string,std::weak_ptr<SMappedFile>>::iterator it=mappedFiles.find(filename);
+    if (it!=mappedFiles.end())
+    {
+        std::shared_ptr<SMappedFile> f=it->second.lock();
+        if ( f&&(f->size==expectedSize) )
+            return(f);
+    }
+    std::shared_ptr<SMappedFile> f(new SMappedFile());
+    if (!f->map(filename))
+        return(nullptr);
+    mappedFiles[filename]=f;
+    for (it=mappedFiles.begin();it!=mappedFiles.end();)
+    { // drop expired entries
+        if (it->second.expired())
+            it=mappedFiles.erase(it);
+        else
+            ++it;
+    }
+    return(f);
+}
+
+CMMapIOSystem::CMMapIOSystem()
+{
+}
+
+CMMapIOSystem::~CMMapIOSystem()
+{
+}
+
+const CMMapIOSystem::SStat& CMMapIOSystem::stat(const std::string& filename) const
+{
+    std::unordered_map<std::string,SStat>::iterator it=_statCache.find(filename);
+    if (it==_statCache.end())
+    {
+        SStat s;
+        std::error_code ec;
+        std::filesystem::path p=std::filesystem::u8path(filename);
+        s.exists=std::filesystem::is_regular_file(p,ec);
+        s.size=0;
+        if (s.exists)
+            s.size=size_t(std::filesystem::file_size(p,ec));
+        it=_statCache.insert(std::make_pair(filename,s)).first;
+    }
+    return(it->second);
+}
+
+bool CMMapIOSystem::Exists(const char* pFile) const
+{
+    return(stat(pFile).exists);
+}
+
+char CMMapIOSystem::getOsSeparator() const
+{
+#ifdef _WIN32
+    return('\\');
+#else
+    return('/');
+#endif
+}
+
+Assimp::IOStream* CMMapIOSystem::Open(const char* pFile,const char* pMode)
+{
+    if ( (strchr(pMode,'w')!=nullptr)||(strchr(pMode,'a')!=nullptr)||(strchr(pMode,'+')!=nullptr) )
+        return(nullptr);
+    const SStat& s=stat(pFile);
+    if (!s.exists)
+        return(nullptr);
+    std::shared_ptr<SMappedFile> f=openMappedFile(pFile,s.size);
+    if (!f)
+        return(nullptr);
+    return(new CMMapIOStream(f));
+}
+
+void CMMapIOSystem::Close(Assimp::IOStream* pFile)
+{
+    delete pFile;
+}
+
+void CMMapIOSystem::clearCache()
+{
+    _statCache.clear();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <assimp/IOSystem.hpp>
+#include <assimp/IOStream.hpp>
+
+// A read-only mapping of a whole file. Shared between all streams that have the same file open
+struct SMappedFile
+{
+    SMappedFile();
+    ~SMappedFile();
+    bool map(const std::string& filename);
+
+    const char* data;
+    size_t size;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#else
+    int fd;
+#endif
+};
+
+class CMMapIOStream : public Assimp::IOStream
+{
+public:
+    CMMapIOStream(const std::shared_ptr<SMappedFile>& file);
+    ~CMMapIOStream() override;
+
+    size_t Read(void* pvBuffer,size_t pSize,size_t pCount) override;
+    size_t Write(const void* pvBuffer,size_t pSize,size_t pCount) override;
+    aiReturn Seek(size_t pOffset,aiOrigin pOrigin) override;
+    size_t Tell() const override;
+    size_t FileSize() const override;
+    void Flush() override;
+
+private:
+    std::shared_ptr<SMappedFile> _file;
+    size_t _position;
+};
+
+// Memory-maps the files Assimp reads (the main file, and e.g. .mtl files or external buffers it pulls in),
+// instead of copying them through fopen/fread. Stat results are cached until clearCache is called, which
+// makes repeated texture path probing cheap. Files are opened read-only; write modes are not supported
+class CMMapIOSystem : public Assimp::IOSystem
+{
+public:
+    CMMapIOSystem();
+    ~CMMapIOSystem() override;
+
+    bool Exists(const char* pFile) const override;
+    char getOsSeparator() const override;
+    Assimp::IOStream* Open(const char* pFile,const char* pMode="rb") override;
+    void Close(Assimp::IOStream* pFile) override;
+
+    void clearCache();
+
+private:
+    struct SStat
+    {
+        bool exists;
+        size_t size;
+    };
+    const SStat& stat(const std::string& filename) const;
+
+    mutable std::unordered_map<std::string,SStat> _statCache;
+};
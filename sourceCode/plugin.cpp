@@ -1,8 +1,28 @@
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <map>
 #include <vector>
 #include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <cmath>
+#include <cctype>
+#include <cfloat>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
 #include <simMath/7Vector.h>
 #include <simStack/stackArray.h>
 #include <simStack/stackMap.h>
@@ -13,10 +33,14 @@
 #include <assimp/postprocess.h>
 #include <assimp/matrix4x4.h>
 #include <assimp/vector3.h>
+#include <zlib.h>
 #include <simPlusPlus/Plugin.h>
 #include "config.h"
 #include "plugin.h"
 #include "stubs.h"
+#include "mmapIOSystem.h"
+#include "imageResampler.h"
+#include "meshConverter.h"
 
 int parseVectorUp(int vu, int def)
 {
@@ -33,23 +57,111 @@ int parseVectorUp(int vu, int def)
     }
 }
 
-void splitString(const std::string& str,char delChar,std::vector<std::string>& words)
+// Exporters are expensive to construct (they instantiate all format handlers), so they are pooled
+// for the plugin's lifetime, like importers (see meshConverter.h). A pooled exporter returns to its pool when released:
+struct SExporterRecycler
 {
-    std::stringstream ss(str);
-    std::string itm;
-    while (std::getline(ss,itm,delChar))
-        words.push_back(itm);
+    void operator()(Assimp::Exporter* exporter) const;
+};
+typedef std::unique_ptr<Assimp::Exporter,SExporterRecycler> PooledExporter;
+
+std::mutex exporterPoolMutex;
+std::vector<std::unique_ptr<Assimp::Exporter>> exporterPool;
+
+void SExporterRecycler::operator()(Assimp::Exporter* exporter) const
+{
+    exporter->FreeBlob();
+    std::lock_guard<std::mutex> lock(exporterPoolMutex);
+    exporterPool.emplace_back(exporter);
+}
+
+PooledExporter acquireExporter()
+{
+    std::lock_guard<std::mutex> lock(exporterPoolMutex);
+    if (exporterPool.size()==0)
+        return(PooledExporter(new Assimp::Exporter()));
+    PooledExporter retVal(exporterPool.back().release());
+    exporterPool.pop_back();
+    return(retVal);
+}
+
+struct SImportFormat
+{
+    std::string description;
+    std::string extensions; // space-separated
+};
+struct SExportFormat
+{
+    std::string description;
+    std::string extension;
+    std::string id;
+};
+// Built once in onInit, read-only afterwards:
+std::vector<SImportFormat> importFormats;
+std::vector<SExportFormat> exportFormats;
+std::unordered_map<std::string,int> importFormatsByExtension;
+std::unordered_map<std::string,int> exportFormatsById;
+std::unordered_map<std::string,int> exportFormatsByExtension;
+
+void buildFormatRegistry()
+{
+    PooledImporter importer=acquireImporter();
+    for (size_t i=0;i<importer->GetImporterCount();i++)
+    {
+        const aiImporterDesc* desc=importer->GetImporterInfo(i);
+        SImportFormat f;
+        f.description=desc->mName;
+        f.extensions=desc->mFileExtensions;
+        importFormats.push_back(f);
+        std::vector<std::string> exts;
+        splitString(f.extensions,' ',exts);
+        for (size_t j=0;j<exts.size();j++)
+        {
+            if (exts[j].size()>0)
+                importFormatsByExtension.emplace(normalizeExtension(exts[j]),int(i)); // first importer wins
+        }
+    }
+    PooledExporter exporter=acquireExporter();
+    for (size_t i=0;i<exporter->GetExportFormatCount();i++)
+    {
+        const aiExportFormatDesc* desc=exporter->GetExportFormatDescription(i);
+        SExportFormat f;
+        f.description=desc->description;
+        f.extension=desc->fileExtension;
+        f.id=desc->id;
+        exportFormats.push_back(f);
+        exportFormatsById.emplace(f.id,int(i));
+        exportFormatsByExtension.emplace(normalizeExtension(f.extension),int(i));
+    }
+}
+
+int findImportFormat(const std::string& extension)
+{
+    std::unordered_map<std::string,int>::const_iterator it=importFormatsByExtension.find(normalizeExtension(extension));
+    if (it==importFormatsByExtension.end())
+        return(-1);
+    return(it->second);
+}
+
+int findExportFormat(const std::string& idOrExtension)
+{
+    std::unordered_map<std::string,int>::const_iterator it=exportFormatsById.find(idOrExtension);
+    if (it!=exportFormatsById.end())
+        return(it->second);
+    it=exportFormatsByExtension.find(normalizeExtension(idOrExtension));
+    if (it==exportFormatsByExtension.end())
+        return(-1);
+    return(it->second);
 }
 
 SIM_DLLEXPORT void simAssimp_getImportFormat(getImportFormat_in *in, getImportFormat_out *out)
 {
     if(in->index < 0) throw std::runtime_error("invalid index");
 
-    Assimp::Importer importer;
-    if (in->index<importer.GetImporterCount())
+    if (in->index<int(importFormats.size()))
     {
-        out->formatDescription=importer.GetImporterInfo(in->index)->mName;
-        out->formatExtension=importer.GetImporterInfo(in->index)->mFileExtensions;
+        out->formatDescription=importFormats[in->index].description;
+        out->formatExtension=importFormats[in->index].extensions;
     }
     else
         simPopStackItem(in->_.stackID,simGetStackSize(in->_.stackID));
@@ -59,344 +171,281 @@ SIM_DLLEXPORT void simAssimp_getExportFormat(getExportFormat_in *in, getExportFo
 {
     if(in->index < 0) throw std::runtime_error("invalid index");
 
-    Assimp::Exporter exporter;
-    if (in->index<exporter.GetExportFormatCount())
+    if (in->index<int(exportFormats.size()))
     {
-        out->formatDescription=exporter.GetExportFormatDescription(in->index)->description;
-        out->formatExtension=exporter.GetExportFormatDescription(in->index)->fileExtension;
-        out->formatId=exporter.GetExportFormatDescription(in->index)->id;
+        out->formatDescription=exportFormats[in->index].description;
+        out->formatExtension=exportFormats[in->index].extension;
+        out->formatId=exportFormats[in->index].id;
     }
     else
         simPopStackItem(in->_.stackID,simGetStackSize(in->_.stackID));
 }
 
-const aiMatrix4x4* getTransform(aiNode* node,const aiMatrix4x4* tr,int meshIndex)
+SIM_DLLEXPORT void simAssimp_getImportFormats(getImportFormats_in *in, getImportFormats_out *out)
 {
-    for (size_t i=0;i<node->mNumMeshes;i++)
+    for (size_t i=0;i<importFormats.size();i++)
     {
-        if (node->mMeshes[i]==meshIndex)
-            return(tr);
+        out->formatDescriptions.push_back(importFormats[i].description);
+        out->formatExtensions.push_back(importFormats[i].extensions);
     }
-    for (size_t i=0;i<node->mNumChildren;i++)
+}
+
+SIM_DLLEXPORT void simAssimp_getExportFormats(getExportFormats_in *in, getExportFormats_out *out)
+{
+    for (size_t i=0;i<exportFormats.size();i++)
     {
-        aiNode* childNode=node->mChildren[i];
-        aiMatrix4x4 tr2=tr[0]*childNode->mTransformation;
-        const aiMatrix4x4* m=getTransform(childNode,&tr2,meshIndex);
-        if (m!=nullptr)
-            return(m);
+        out->formatDescriptions.push_back(exportFormats[i].description);
+        out->formatExtensions.push_back(exportFormats[i].extension);
+        out->formatIds.push_back(exportFormats[i].id);
     }
-    return(nullptr);
 }
 
-void assimpImportShapes(const char* fileNames,int maxTextures,double scaling,int upVector,int options,std::vector<int>& shapeHandles)
+SIM_DLLEXPORT void simAssimp_findImportFormat(findImportFormat_in *in, findImportFormat_out *out)
 {
-    std::vector<std::string> filenames;
-    splitString(fileNames,';',filenames);
-    for (size_t wi=0;wi<filenames.size();wi++)
+    out->index=findImportFormat(in->extension);
+}
+
+SIM_DLLEXPORT void simAssimp_findExportFormat(findExportFormat_in *in, findExportFormat_out *out)
+{
+    out->index=findExportFormat(in->formatIdOrExtension);
+}
+
+void converterLog(const std::string& txt)
+{ // the conversion core is only called from the main thread, and logs from there
+    simAddLog("Assimp",sim_verbosity_infos,txt.c_str());
+}
+
+void decodeTextures(std::vector<SImportTexture>& textures,int maxTextures,int textureScaling)
+{ // decodes compressed and external textures, then scales them down to maxTextures. Textures that cannot be decoded stay empty
+    for (size_t i=0;i<textures.size();i++)
     {
-        std::string shapeAlias(filenames[wi]);
-        std::size_t si=shapeAlias.find_last_of("/\\");
-        if (si!=std::string::npos)
-            shapeAlias=shapeAlias.substr(si+1);
-        si=shapeAlias.find_last_of(".");
-        if (si!=std::string::npos)
-            shapeAlias=shapeAlias.substr(0,si);
-        
-        if ((options&256)==0)
+        SImportTexture& t=textures[i];
+        if (t.image.size()==0)
         {
-            std::string txt("importing ");
-            txt+=filenames[wi];
-            simAddLog("Assimp",sim_verbosity_infos,txt.c_str());
+            unsigned char* img=nullptr;
+            if (t.data.size()>0)
+            {
+                int l=int(t.data.size());
+                img=(unsigned char*)simLoadImage(t.res,1,t.data.data(),(int*)(&l));
+            }
+            else if (t.filename.size()>0)
+                img=(unsigned char*)simLoadImage(t.res,1,t.filename.c_str(),nullptr);
+            if (img!=nullptr)
+            {
+                t.image.assign(img,img+4*size_t(t.res[0])*t.res[1]);
+                simReleaseBuffer((char*)img);
+            }
         }
-        std::vector<int> shapeHandlesForThisFile;
-        bool hasMaterials=false;
-        Assimp::Importer importer;
-        importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS,aiComponent_ANIMATIONS|aiComponent_LIGHTS|aiComponent_CAMERAS);
-        importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE,aiPrimitiveType_POINT|aiPrimitiveType_LINE);
-        int flags=aiProcess_Triangulate|aiProcess_OptimizeGraph|
-                aiProcess_SortByPType|aiProcess_RemoveComponent|aiProcess_DropNormals|
-                aiProcess_RemoveRedundantMaterials|aiProcess_FindDegenerates|aiProcess_FindInvalidData|
-                aiProcess_GenUVCoords|aiProcess_TransformUVCoords|aiProcess_EmbedTextures;
-
-        if ((options&32)!=0)
-            options=(options|24)-24;
-        if ((options&8)==0)
-            flags|=aiProcess_OptimizeMeshes;
-        if ((options&16)==0)
-            flags|=aiProcess_JoinIdenticalVertices;
-
-        if ((options&128)!=0)
-            importer.SetPropertyInteger(AI_CONFIG_IMPORT_COLLADA_IGNORE_UP_DIRECTION,1);
-        const aiScene* scene = importer.ReadFile(filenames[wi].c_str(),flags);
-        if(scene)
+        t.data.clear();
+    }
+    parallelFor(textures.size(),[&](size_t i)
+    {
+        SImportTexture& t=textures[i];
+        std::vector<unsigned char> scaled;
+        int resOut[2];
+        if ( (t.image.size()>0)&&scaleTexture(t.image.data(),t.res,maxTextures,textureScaling,scaled,resOut) )
         {
-            double minMaxX[2]={9999999.0,-9999999.0};
-            double minMaxY[2]={9999999.0,-9999999.0};
-            double minMaxZ[2]={9999999.0,-9999999.0};
-            for (size_t i=0;i<scene->mNumMeshes;i++)
+            t.image.swap(scaled);
+            t.res[0]=resOut[0];
+            t.res[1]=resOut[1];
+        }
+    });
+}
+
+struct SImportedFile
+{ // the shapes of a file, ready to be created
+    std::vector<SImportMesh> meshes;
+    std::vector<SImportTexture> textures;
+    std::vector<SMeshFrame> frames; // the frames the mesh vertices are expressed in (options 64 and 4096), or empty
+    SMeshFrame groupFrame; // with options 32 and 4096
+    bool hasMaterials;
+};
+
+C7Vector getFramePose(const SMeshFrame& frame)
+{
+    C3X3Matrix m(C3Vector(frame.axes+0),C3Vector(frame.axes+3),C3Vector(frame.axes+6));
+    return(C7Vector(m.getQuaternion(),C3Vector(frame.position)));
+}
+
+void poseToArray(const C7Vector& tr,double* pose)
+{ // x, y, z, qx, qy, qz, qw
+    for (size_t i=0;i<3;i++)
+        pose[i]=tr.X(i);
+    pose[3]=tr.Q(1);
+    pose[4]=tr.Q(2);
+    pose[5]=tr.Q(3);
+    pose[6]=tr.Q(0);
+}
+
+struct SShapeCreationStats
+{
+    size_t simCalls;
+    double seconds;
+};
+
+void createShapes(const SImportedFile& file,int options,std::vector<float>& defaultColors,std::vector<int>& shapeHandles,std::vector<int>& tileHandles,SShapeCreationStats& stats)
+{ // shapeHandles receives the shapes that are not tiles. Color components equal to the ones simCreateShape assigns are not set.
+  // defaultColors holds those (ambient-diffuse, specular, emission), read from the first shape created
+    const int components[3]={sim_colorcomponent_ambient_diffuse,sim_colorcomponent_specular,sim_colorcomponent_emission};
+    std::map<int,std::vector<int>> tileGroups; // tiles of a same mesh. Those are never merged back with option 32
+    std::map<int,std::string> tileGroupAliases;
+    for (size_t i=0;i<file.meshes.size();i++)
+    {
+        const SImportMesh& m=file.meshes[i];
+        const SImportTexture* t=(m.texture>=0)?&file.textures[m.texture]:nullptr;
+        int h=simCreateShape(16,0,m.vertices.data(),int(m.vertices.size()),m.indices.data(),int(m.indices.size()),nullptr,(t!=nullptr)?m.textureCoords.data():nullptr,(t!=nullptr)?t->image.data():nullptr,(t!=nullptr)?t->res:nullptr);
+        simSetObjectAlias(h,m.alias.c_str(),0);
+        stats.simCalls+=2;
+
+        if (file.frames.size()>0)
+        { // the vertices were given in the mesh's frame: move the shape by that frame. This keeps its geometry in place and aligns it with the frame
+            double pose[7];
+            simGetObjectPose(h,-1,pose);
+            C7Vector created(C4Vector(pose[6],pose[3],pose[4],pose[5]),C3Vector(pose));
+            poseToArray(getFramePose(file.frames[i])*created,pose);
+            simSetObjectPose(h,-1,pose);
+            stats.simCalls+=2;
+        }
+
+        if (defaultColors.size()==0)
+        {
+            defaultColors.resize(9);
+            for (size_t c=0;c<3;c++)
             {
-                const aiMatrix4x4* tr=getTransform(scene->mRootNode,&scene->mRootNode->mTransformation,i);
-                const aiMesh* mesh = scene->mMeshes[i];
-                for (size_t j=0;j<mesh->mNumVertices;j++)
-                {
-                    if (tr!=nullptr)
-                        mesh->mVertices[j]*=tr[0];
-                    if (mesh->mVertices[j].x<minMaxX[0])
-                        minMaxX[0]=mesh->mVertices[j].x;
-                    if (mesh->mVertices[j].x>minMaxX[1])
-                        minMaxX[1]=mesh->mVertices[j].x;
-                    if (mesh->mVertices[j].y<minMaxY[0])
-                        minMaxY[0]=mesh->mVertices[j].y;
-                    if (mesh->mVertices[j].y>minMaxY[1])
-                        minMaxY[1]=mesh->mVertices[j].y;
-                    if (mesh->mVertices[j].z<minMaxZ[0])
-                        minMaxZ[0]=mesh->mVertices[j].z;
-                    if (mesh->mVertices[j].z>minMaxZ[1])
-                        minMaxZ[1]=mesh->mVertices[j].z;
-                }
+                if (simGetShapeColor(h,nullptr,components[c],&defaultColors[3*c])<=0)
+                    defaultColors[3*c]=-1.0f; // unknown: always set
+                stats.simCalls++;
             }
-            double l=std::max<double>(minMaxX[1]-minMaxX[0],std::max<double>(minMaxY[1]-minMaxY[0],minMaxZ[1]-minMaxZ[0]));
-            if (scaling==0.0)
+        }
+        const float* colors[3]={m.colorAD,m.colorS,m.colorE};
+        for (size_t c=0;c<3;c++)
+        {
+            if ( (colors[c][0]!=defaultColors[3*c+0])||(colors[c][1]!=defaultColors[3*c+1])||(colors[c][2]!=defaultColors[3*c+2]) )
             {
-                scaling=1.0;
-                while (l>5.0)
-                {
-                    l*=0.1;
-                    scaling*=0.1;
-                }
-                while (l<0.05)
-                {
-                    l*=10.0;
-                    scaling*=10.0;
-                }
+                simSetShapeColor(h,nullptr,components[c],colors[c]);
+                stats.simCalls++;
             }
-            if (upVector==0)
+        }
+        if (m.transparency!=0.0f)
+        {
+            simSetShapeColor(h,nullptr,sim_colorcomponent_transparency,&m.transparency);
+            stats.simCalls++;
+        }
+        if (m.tileGroup>=0)
+        {
+            tileGroups[m.tileGroup].push_back(h);
+            tileGroupAliases[m.tileGroup]=m.alias.substr(0,m.alias.rfind("_tile")); // i.e. the alias of the mesh the tile was cut from
+        }
+        else
+            shapeHandles.push_back(h);
+    }
+
+    for (std::map<int,std::vector<int>>::iterator it=tileGroups.begin();it!=tileGroups.end();it++)
+    {
+        if ((options&512)!=0)
+        { // tiles of a mesh are parented to a common dummy
+            int d=simCreateDummy(0.01,nullptr);
+            simSetObjectAlias(d,tileGroupAliases[it->first].c_str(),0);
+            for (size_t j=0;j<it->second.size();j++)
+                simSetObjectParent(it->second[j],d,true);
+            stats.simCalls+=2+it->second.size();
+        }
+        tileHandles.insert(tileHandles.end(),it->second.begin(),it->second.end());
+    }
+}
+
+void assimpImportShapes(const std::vector<SImportSource>& sources,int maxTextures,double scaling,int upVector,int options,int maxTileTriangles,double weldTolerance,int textureScaling,std::vector<int>& shapeHandles)
+{ // mesh caches (see meshConverter.h) are already scaled and oriented. They still go through texture scaling and post-processing.
+  // All files are prepared first, then all shapes are created in one go, with as few sim calls as possible, and selected once at the end
+    std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+    std::vector<SImportedFile> files(sources.size());
+    std::vector<bool> loaded(sources.size(),false);
+    double readSeconds=0.0;
+    double textureSeconds=0.0;
+    double processSeconds=0.0;
+    for (size_t wi=0;wi<sources.size();wi++)
+    {
+        if ((options&256)==0)
+        {
+            std::string txt("importing ");
+            txt+=sources[wi].name;
+            simAddLog("Assimp",sim_verbosity_infos,txt.c_str());
+        }
+        SImportedFile& file=files[wi];
+        file.hasMaterials=false;
+        std::chrono::steady_clock::time_point t=std::chrono::steady_clock::now();
+        if (isMeshCache(sources[wi]))
+        {
+            loaded[wi]=loadMeshCache(sources[wi],file.meshes,file.textures,file.hasMaterials);
+            if ( (!loaded[wi])&&((options&256)==0) )
             {
-                if (minMaxZ[0]>=minMaxY[0])
-                    upVector=1;
-                else
-                    upVector=2;
+                std::string txt("invalid mesh cache ");
+                txt+=sources[wi].name;
+                simAddLog("Assimp",sim_verbosity_errors,txt.c_str());
             }
-            struct STexture
+        }
+        else
+        {
+            PooledImporter importer=acquireImporter();
+            int flags=prepareImporter(*importer,options);
+            const aiScene* scene = readScene(*importer,sources[wi],flags);
+            if(scene)
             {
-                int imgRes[2];
-                bool releaseBuffer;
-                unsigned char* image;
-            };
-            std::map<int,STexture> allTransformedTextures;
-            for (size_t i=0;i<scene->mNumMeshes;i++)
+                transformVertices(scene,scaling,upVector);
+                file.hasMaterials=extractMeshes(scene,sources[wi],importer->GetIOHandler(),scaling,upVector,options,file.meshes,file.textures);
+                loaded[wi]=true;
+            }
+        }
+        std::chrono::steady_clock::time_point t2=std::chrono::steady_clock::now();
+        readSeconds+=std::chrono::duration<double>(t2-t).count();
+        if (loaded[wi])
+        {
+            decodeTextures(file.textures,maxTextures,textureScaling);
+            for (size_t i=0;i<file.meshes.size();i++)
             {
-                const aiMesh* mesh = scene->mMeshes[i];
-                const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-                std::vector<double> vertices;
-                std::vector<int> indices;
-                for (size_t j=0;j<mesh->mNumVertices;j++)
-                {
-                    if (upVector==1)
-                    {
-                        vertices.push_back(mesh->mVertices[j].x*scaling);
-                        vertices.push_back(mesh->mVertices[j].y*scaling);
-                        vertices.push_back(mesh->mVertices[j].z*scaling);
-                    }
-                    else
-                    {
-                        vertices.push_back(mesh->mVertices[j].x*scaling);
-                        vertices.push_back(-mesh->mVertices[j].z*scaling);
-                        vertices.push_back(mesh->mVertices[j].y*scaling);
-                    }
-                }
-                for (size_t j=0;j<mesh->mNumFaces;j++)
+                SImportMesh& m=file.meshes[i];
+                if ( (m.texture>=0)&&(file.textures[m.texture].image.size()==0) )
                 {
-                    const aiFace& face=mesh->mFaces[j];
-                    indices.push_back(face.mIndices[0]);
-                    indices.push_back(face.mIndices[1]);
-                    indices.push_back(face.mIndices[2]);
+                    m.texture=-1;
+                    m.textureCoords.clear();
                 }
-                
-                // Ok, we have vertices and indices ready. What about a texture?
-                std::vector<float> _textureCoords;
-                float* textureCoords=nullptr; 
-                unsigned char* imgg=nullptr;
-                int imggRes[2];
-                aiString texPath;
-                bool hasTexture=false;
-                if ( ((options&1)==0)&&(mesh->HasTextureCoords(0))&&(aiReturn_SUCCESS==aiGetMaterialTexture(material,aiTextureType_DIFFUSE,0,&texPath)) )
-                {
-                    for (size_t j=0;j<indices.size();j++)
-                    {
-                        int index=indices[j];
-                        const aiVector3D& textureVect=mesh->mTextureCoords[0][index];
-                        _textureCoords.push_back(float(textureVect.x));
-                        _textureCoords.push_back(float(textureVect.y));
-                    }
-                    std::string p=std::string(texPath.C_Str());
-                    const aiTexture* texture=nullptr;
-                    int index=-1;
-                    if ( (p.size()>1)&&(p[0]=='*') )
-                    {
-                        p.erase(0,1);
-                        index=std::stoi(p);
-                        texture=scene->mTextures[index];
-                    }
-                    if (_textureCoords.size()>0)
+            }
+            std::chrono::steady_clock::time_point t3=std::chrono::steady_clock::now();
+            textureSeconds+=std::chrono::duration<double>(t3-t2).count();
+            processMeshes(file.meshes,file.textures,maxTextures,options,maxTileTriangles,weldTolerance);
+            if ((options&(64|4096))!=0)
+            { // shape frames are computed here in parallel, instead of realigning each shape once created
+                if ((options&(32|4096))==(32|4096))
+                { // the frame of the group the file's shapes will form. Tiles are not part of it
+                    std::vector<double> vertices;
+                    for (size_t i=0;i<file.meshes.size();i++)
                     {
-                        if (texture!=nullptr)
-                        {
-                            unsigned char* img=nullptr;
-                            int res[2];
-                            bool deleteTexture=true;
-                            if (texture->mHeight==0)
-                            {
-                                int l=(int)texture->mWidth;
-                                img=(unsigned char*)simLoadImage(res,1,(char*)texture->pcData,(int*)(&l));
-                            }
-                            else
-                            {
-                                img=(unsigned char*)texture->pcData;
-                                res[0]=texture->mWidth;
-                                res[1]=texture->mHeight;
-                                deleteTexture=false;
-                            }
-                            std::map<int,STexture>::iterator textIt=allTransformedTextures.find(index);
-                            if (textIt!=allTransformedTextures.end())
-                            {
-                                if (deleteTexture)
-                                    simReleaseBuffer((char*)img);
-                            }
-                            else
-                            {
-                                if ( (res[0]>maxTextures)||(res[1]>maxTextures) )
-                                {
-                                    int resOut[2]={std::min<int>(maxTextures,res[0]),std::min<int>(maxTextures,res[1])};
-                                    unsigned char* imgOut=simGetScaledImage(img,res,resOut,1+2,NULL);
-                                    if (deleteTexture)
-                                        simReleaseBuffer((char*)img);
-                                    img=imgOut;
-                                    res[0]=resOut[0];
-                                    res[1]=resOut[1];
-                                }
-                                STexture im;
-                                im.imgRes[0]=res[0];
-                                im.imgRes[1]=res[1];
-                                im.releaseBuffer=deleteTexture;
-                                im.image=img;
-                                allTransformedTextures[index]=im;
-                                textIt=allTransformedTextures.find(index);
-                            }
-                            hasTexture=true;
-                            hasMaterials=true;
-                            textureCoords=_textureCoords.data();
-                            imgg=textIt->second.image;
-                            imggRes[0]=textIt->second.imgRes[0];
-                            imggRes[1]=textIt->second.imgRes[1];
-                            //simApplyTexture(h,&textureCoords[0],textureCoords.size(),textIt->second.image,textIt->second.imgRes,16);
-                        }
-                        else
-                        {
-                            std::filesystem::path pp(filenames[wi]);
-                            pp=pp.parent_path();
-                            std::string loc[6]={pp.string()+"/"+p,pp.string()+"/textures/"+p,pp.string()+"/../"+p,pp.string()+"/../textures/"+p,pp.string()+"/../materials/"+p,pp.string()+"/../materials/textures/"+p};
-                            std::string fn;
-                            for (size_t fi=0;fi<6;fi++)
-                            {
-                                if (simDoesFileExist(loc[fi].c_str())==1)
-                                    fn=loc[fi];
-                            }
-                                printf("Final File: %s\n",fn.c_str());
-                            if (fn.size()>0)
-                            {
-                                int res[2];
-                                unsigned char* img=(unsigned char*)simLoadImage(res,1,fn.c_str(),nullptr);
-                                if ( (res[0]>maxTextures)||(res[1]>maxTextures) )
-                                {
-                                    int resOut[2]={std::min<int>(maxTextures,res[0]),std::min<int>(maxTextures,res[1])};
-                                    unsigned char* imgOut=simGetScaledImage(img,res,resOut,1+2,NULL);
-                                    simReleaseBuffer((char*)img);
-                                    img=imgOut;
-                                    res[0]=resOut[0];
-                                    res[1]=resOut[1];
-                                }
-                                STexture im;
-                                im.imgRes[0]=res[0];
-                                im.imgRes[1]=res[1];
-                                im.releaseBuffer=true;
-                                im.image=img;
-                                allTransformedTextures[0]=im; // only one texture with textures with specfic name?
-                                std::map<int,STexture>::iterator textIt=allTransformedTextures.find(0);
-                                hasTexture=true;
-                                hasMaterials=true;
-                                textureCoords=_textureCoords.data();
-                                imgg=textIt->second.image;
-                                imggRes[0]=textIt->second.imgRes[0];
-                                imggRes[1]=textIt->second.imgRes[1];
-                                //simApplyTexture(h,&textureCoords[0],textureCoords.size(),textIt->second.image,textIt->second.imgRes,16);
-                            }
-                        }
+                        if (file.meshes[i].tileGroup<0)
+                            vertices.insert(vertices.end(),file.meshes[i].vertices.begin(),file.meshes[i].vertices.end());
                     }
+                    computeMeshFrame(vertices.data(),vertices.size()/3,true,file.groupFrame);
                 }
-                
-                int h=simCreateShape(16,0,&vertices[0],vertices.size(),&indices[0],indices.size(),nullptr,textureCoords,imgg,imggRes);
-                std::string sha(shapeAlias);
-                if (scene->mNumMeshes>1)
-                {
-                    sha+="_";
-                    sha+=std::to_string(i);
-                }
-                simSetObjectAlias(h,sha.c_str(),0);
-                
-                if ((options&64)!=0)
-                {
-                    double ident[7]={0.0,0.0,0.0,0.0,0.0,0.0,1.0};
-                    simAlignShapeBB(h,ident);
-                }
-
-                aiColor3D colorA(0.499,0.499,0.499);
-                aiColor3D colorD(0.499,0.499,0.499);
-                aiColor3D colorS(0.0,0.0,0.0);
-                aiColor3D colorE(0.0,0.0,0.0);
-                if ((options&2)==0)
-                {
-                    material->Get(AI_MATKEY_COLOR_AMBIENT,colorA);
-                    material->Get(AI_MATKEY_COLOR_DIFFUSE,colorD);
-                    material->Get(AI_MATKEY_COLOR_SPECULAR,colorS);
-                    material->Get(AI_MATKEY_COLOR_EMISSIVE,colorE);
-                }
-                double opacity=1.0;
-                if ((options&4)==0)
-                    material->Get(AI_MATKEY_OPACITY,opacity);
-                float ca[3]={(float)colorA.r,(float)colorA.g,(float)colorA.b};
-                float cd[3]={(float)colorD.r,(float)colorD.g,(float)colorD.b};
-                float cs[3]={(float)colorS.r,(float)colorS.g,(float)colorS.b};
-                float ce[3]={(float)colorE.r,(float)colorE.g,(float)colorE.b};
-                if ( hasTexture&&(ca[0]==0.0f)&&(ca[1]==0.0f)&&(ca[2]==0.0f) )
-                {
-                    ca[0]=0.499f;
-                    ca[1]=0.499f;
-                    ca[2]=0.499f;
-                }
-                float cad[3]={std::max<float>(ca[0],cd[0]),std::max<float>(ca[1],cd[1]),std::max<float>(ca[2],cd[2])};
-                simSetShapeColor(h,nullptr,sim_colorcomponent_ambient_diffuse,cad);
-                simSetShapeColor(h,nullptr,sim_colorcomponent_specular,cs);
-                simSetShapeColor(h,nullptr,sim_colorcomponent_emission,ce);
-                if ( (ca[0]!=0.499f)||(ca[1]!=0.499f)||(ca[2]!=0.499f) )
-                    hasMaterials=true;
-                if ( (cd[0]!=0.499f)||(cd[1]!=0.499f)||(cd[2]!=0.499f) )
-                    hasMaterials=true;
-                if (opacity!=1.0)
-                {
-                    float tr=float(1.0-opacity);
-                    simSetShapeColor(h,nullptr,sim_colorcomponent_transparency,&tr);
-                }
-                shapeHandlesForThisFile.push_back(h);
-            }
-            // Free textures that need freedom:
-            std::map<int,STexture>::iterator textIt;
-            for (textIt=allTransformedTextures.begin();textIt!=allTransformedTextures.end();textIt++)
-            {
-                if (textIt->second.releaseBuffer)
-                    simReleaseBuffer((char*)textIt->second.image);
+                frameMeshes(file.meshes,(options&4096)!=0,file.frames);
             }
-            allTransformedTextures.clear();
+            processSeconds+=std::chrono::duration<double>(std::chrono::steady_clock::now()-t3).count();
+        }
+    }
+
+    std::chrono::steady_clock::time_point t1=std::chrono::steady_clock::now();
+    SShapeCreationStats stats;
+    stats.simCalls=0;
+    size_t shapeCnt=0;
+    std::vector<float> defaultColors;
+    for (size_t wi=0;wi<files.size();wi++)
+    {
+        std::vector<int> shapeHandlesForThisFile;
+        bool hasMaterials=files[wi].hasMaterials;
+        if (loaded[wi])
+        {
+            createShapes(files[wi],options,defaultColors,shapeHandlesForThisFile,shapeHandles,stats);
+            shapeCnt+=files[wi].meshes.size();
+            std::vector<SImportMesh>().swap(files[wi].meshes); // release the mesh data early
+            std::vector<SImportTexture>().swap(files[wi].textures);
         }
         if ( ((options&32)!=0)&&(shapeHandlesForThisFile.size()>1) )
         {
@@ -405,13 +454,35 @@ void assimpImportShapes(const char* fileNames,int maxTextures,double scaling,int
                 s=-1;
             int h=simGroupShapes(&shapeHandlesForThisFile[0],s*int(shapeHandlesForThisFile.size()));
             shapeHandles.push_back(h);
-            if ((options&64)!=0)
+            stats.simCalls++;
+            if ((options&4096)!=0)
+            { // a group's frame cannot be given at creation
+                double pose[7];
+                poseToArray(getFramePose(files[wi].groupFrame),pose);
+                simAlignShapeBB(h,pose);
+                stats.simCalls++;
+            }
+            else if ((options&64)!=0)
+            {
                 simReorientShapeBoundingBox(h,-1,0);
+                stats.simCalls++;
+            }
         }
         else
             shapeHandles.insert(shapeHandles.end(),shapeHandlesForThisFile.begin(),shapeHandlesForThisFile.end());
     }
     simSetObjectSel(shapeHandles.data(),int(shapeHandles.size()));
+    stats.simCalls++;
+    std::chrono::steady_clock::time_point t4=std::chrono::steady_clock::now();
+    stats.seconds=std::chrono::duration<double>(t4-t1).count();
+
+    if ((options&256)==0)
+    {
+        char txt[400];
+        snprintf(txt,sizeof(txt),"import timings: reading %.3f s, textures %.3f s, processing %.3f s, shape creation %.3f s (%zu shapes, %zu sim calls, %.1f us per call), total %.3f s",
+                 readSeconds,textureSeconds,processSeconds,stats.seconds,shapeCnt,stats.simCalls,(stats.simCalls>0)?1000000.0*stats.seconds/double(stats.simCalls):0.0,std::chrono::duration<double>(t4-t0).count());
+        simAddLog("Assimp",sim_verbosity_infos,txt);
+    }
 }
 
 SIM_DLLEXPORT void simAssimp_importShapes(importShapes_in *in, importShapes_out *out)
@@ -421,495 +492,1952 @@ SIM_DLLEXPORT void simAssimp_importShapes(importShapes_in *in, importShapes_out
     if(in->upVector < 0) throw std::runtime_error("invalid upVector");
     if(in->upVector > 2) throw std::runtime_error("invalid upVector");
     if(in->options < 0) throw std::runtime_error("invalid options");
+    if(in->maxTileTriangles < 0) throw std::runtime_error("invalid maxTileTriangles");
+    if(in->weldTolerance < 0.0) throw std::runtime_error("invalid weldTolerance");
+    if( (in->textureScaling < 0)||(in->textureScaling > 6)||((in->textureScaling&3)==3) ) throw std::runtime_error("invalid textureScaling");
 
     std::vector<int> handles;
-    assimpImportShapes(in->filenames.c_str(),in->maxTextureSize,in->scaling,parseVectorUp(in->upVector,0),in->options,handles);
+    assimpImportShapes(getFileSources(in->filenames.c_str()),in->maxTextureSize,in->scaling,parseVectorUp(in->upVector,0),in->options,in->maxTileTriangles,in->weldTolerance,in->textureScaling,handles);
     out->shapeHandles.assign(handles.begin(),handles.end());
 }
 
-void assimpExportShapes(const std::vector<int>& shapeHandles,const char* filename,const char* format,double scaling,int upVector,int options)
+SIM_DLLEXPORT void simAssimp_importShapesFromBuffer(importShapesFromBuffer_in *in, importShapesFromBuffer_out *out)
 {
-    if ((options&256)==0)
-    {
-        std::string txt("exporting ");
-        txt+=filename;
-        simAddLog("Assimp",sim_verbosity_infos,txt.c_str());
-    }
+    if(in->data.size() == 0) throw std::runtime_error("invalid data");
+    if(in->maxTextureSize < 8) throw std::runtime_error("invalid maxTextureSize");
+    if(in->scaling < 0.0) throw std::runtime_error("invalid scaling");
+    if(in->upVector < 0) throw std::runtime_error("invalid upVector");
+    if(in->upVector > 2) throw std::runtime_error("invalid upVector");
+    if(in->options < 0) throw std::runtime_error("invalid options");
+    if(in->maxTileTriangles < 0) throw std::runtime_error("invalid maxTileTriangles");
+    if(in->weldTolerance < 0.0) throw std::runtime_error("invalid weldTolerance");
+    if( (in->textureScaling < 0)||(in->textureScaling > 6)||((in->textureScaling&3)==3) ) throw std::runtime_error("invalid textureScaling");
 
-    struct SShape
-    {
-        double* vertices;
-        int verticesSize;
-        int* indices;
-        int indicesSize;
-        double* normals;
-        double colorAD[3];
-        double colorS[3];
-        double colorE[3];
-        int textureId;
-        float* textureCoordinates;
-    };
-    struct STexture
-    {
-        int imgRes[2];
-        unsigned char* image;
-        int textureId;
-        std::string filename;
-    };
-    std::map<int,STexture> allTextures;
-    int texturesCnt=0;
-    std::vector<SShape> allShapeComponents;
-    std::string filenameNoExt(filename);
-    size_t ll=filenameNoExt.find_last_of('.');
-    if (ll!=std::string::npos)
-        filenameNoExt.resize(ll);
-    C7Vector firstTrInv;
-    for (size_t shapeI=0;shapeI<shapeHandles.size();shapeI++)
-    {
-        int h=shapeHandles[shapeI];
+    std::vector<int> handles;
+    assimpImportShapes(getBufferSource(in->data.data(),in->data.size(),in->formatHint.c_str()),in->maxTextureSize,in->scaling,parseVectorUp(in->upVector,0),in->options,in->maxTileTriangles,in->weldTolerance,in->textureScaling,handles);
+    out->shapeHandles.assign(handles.begin(),handles.end());
+}
 
-        if (shapeI==0)
+struct SVoxel
+{
+    double sum[3];
+    unsigned long long colorSum[3];
+    unsigned long long cnt;
+};
+
+void downsamplePoints(std::vector<double>& points,std::vector<unsigned char>& colors,double voxelSize)
+{ // replaces the points falling into a same voxel by their centroid (and average color). Each thread bins a slice of the points into
+  // per-shard hash maps, then each shard is merged by one thread
+    size_t ptCnt=points.size()/3;
+    size_t threadCnt=std::min<size_t>(std::max<size_t>(1,std::thread::hardware_concurrency()),std::max<size_t>(1,ptCnt/65536));
+    size_t shardCnt=threadCnt;
+    bool hasColors=(colors.size()>0);
+    typedef std::unordered_map<SWeldCell,SVoxel,SWeldCellHash> VoxelMap;
+    std::vector<std::vector<VoxelMap>> bins(threadCnt,std::vector<VoxelMap>(shardCnt));
+    SWeldCellHash hasher;
+    parallelFor(threadCnt,[&](size_t t)
+    {
+        size_t first=ptCnt*t/threadCnt;
+        size_t last=ptCnt*(t+1)/threadCnt;
+        for (size_t i=first;i<last;i++)
         {
-            simGetObjectPosition(h,-1,firstTrInv.X.data);
-            double q[4];
-            simGetObjectQuaternion(h,-1,q);
-            firstTrInv.Q=C4Vector(q[3],q[0],q[1],q[2]);
-            firstTrInv.inverse();
+            const double* p=&points[3*i];
+            SWeldCell cell;
+            for (size_t k=0;k<3;k++)
+                cell.c[k]=(long long)std::floor(p[k]/voxelSize);
+            SVoxel& v=bins[t][hasher(cell)%shardCnt][cell]; // value-initialized, i.e. zeroed, when new
+            for (size_t k=0;k<3;k++)
+            {
+                v.sum[k]+=p[k];
+                if (hasColors)
+                    v.colorSum[k]+=colors[3*i+k];
+            }
+            v.cnt++;
         }
-        C7Vector tr;
-        simGetObjectPosition(h,-1,tr.X.data);
-        double q[4];
-        simGetObjectQuaternion(h,-1,q);
-        tr.Q=C4Vector(q[3],q[0],q[1],q[2]);
-        if ((options&512)!=0)
-            tr=firstTrInv*tr;
-        int visible;
-        simGetObjectInt32Param(h,sim_objintparam_visible,&visible);
-        if ( ((options&8)==0)||(visible!=0) )
+    });
+    std::vector<std::vector<double>> shardPoints(shardCnt);
+    std::vector<std::vector<unsigned char>> shardColors(shardCnt);
+    parallelFor(shardCnt,[&](size_t s)
+    {
+        VoxelMap& merged=bins[0][s];
+        for (size_t t=1;t<threadCnt;t++)
         {
-            int compoundIndex=0;
-            SShapeVizInfo shapeInfo;
-            int res=simGetShapeViz(h,compoundIndex++,&shapeInfo);
-            while (res>0)
+            for (VoxelMap::iterator it=bins[t][s].begin();it!=bins[t][s].end();it++)
             {
-                if ((shapeInfo.textureOptions&8)==0)
-                { // component is not wireframe (we ignore wireframe components)
-                    double* __vert=nullptr;
-                    if ((options&5)==5)
-                    { // we drop textures and normals
-                        __vert=shapeInfo.vertices;
-                    }
-                    else
-                    { // we keep normals and/or textures. We need to duplicate vertices:
-                        __vert=(double*)simCreateBuffer(3*shapeInfo.indicesSize*sizeof(double));
-                        for (int i=0;i<shapeInfo.indicesSize;i++)
-                        {
-                            __vert[3*i+0]=shapeInfo.vertices[3*shapeInfo.indices[i]+0];
-                            __vert[3*i+1]=shapeInfo.vertices[3*shapeInfo.indices[i]+1];
-                            __vert[3*i+2]=shapeInfo.vertices[3*shapeInfo.indices[i]+2];
-                            shapeInfo.indices[i]=i;
-                        }
-                        simReleaseBuffer((char*)shapeInfo.vertices);
-                        shapeInfo.verticesSize=3*shapeInfo.indicesSize;
-                    }
-                    SShape s;
-                    s.vertices=__vert;
-                    s.verticesSize=shapeInfo.verticesSize;
-                    for (int i=0;i<s.verticesSize/3;i++)
-                    { // correctly transform the vertices:
-                        C3Vector v(s.vertices+3*i);
-                        v=tr*v;
-                        if (upVector==1)
-                        {
-                            s.vertices[3*i+0]=v(0)*scaling;
-                            s.vertices[3*i+1]=v(1)*scaling;
-                            s.vertices[3*i+2]=v(2)*scaling;
-                        }
-                        else
-                        {
-                            s.vertices[3*i+0]=v(0)*scaling;
-                            s.vertices[3*i+1]=v(2)*scaling;
-                            s.vertices[3*i+2]=-v(1)*scaling;
-                        }
-                    }
-                    s.indices=shapeInfo.indices;
-                    s.indicesSize=shapeInfo.indicesSize;
-
-                    s.normals=shapeInfo.normals;
-                    for (int i=0;i<s.indicesSize;i++)
-                    { // correctly transform the normals:
-                        C3Vector v(s.normals+3*i);
-                        v=tr.Q*v;
-                        s.normals[3*i+0]=v(0);
-                        s.normals[3*i+1]=v(1);
-                        s.normals[3*i+2]=v(2);
-                    }
-                    s.colorAD[0]=shapeInfo.colors[0];
-                    s.colorAD[1]=shapeInfo.colors[1];
-                    s.colorAD[2]=shapeInfo.colors[2];
-                    s.colorS[0]=shapeInfo.colors[3];
-                    s.colorS[1]=shapeInfo.colors[4];
-                    s.colorS[2]=shapeInfo.colors[5];
-                    s.colorE[0]=shapeInfo.colors[6];
-                    s.colorE[1]=shapeInfo.colors[7];
-                    s.colorE[2]=shapeInfo.colors[8];
-                    if ( (shapeInfo.texture!=nullptr)&&((options&1)==0) )
+                SVoxel& v=merged[it->first];
+                if (v.cnt==0)
+                    v=it->second;
+                else
+                {
+                    for (size_t k=0;k<3;k++)
                     {
-                        s.textureId=shapeInfo.textureId;
-                        std::map<int,STexture>::iterator textIt=allTextures.find(s.textureId);
-                        if (textIt==allTextures.end())
-                        {
-                            STexture t;
-                            t.image=(unsigned char*)shapeInfo.texture;
-                            t.imgRes[0]=shapeInfo.textureRes[0];
-                            t.imgRes[1]=shapeInfo.textureRes[1];
-                            t.textureId=shapeInfo.textureId;
-                            t.filename=filenameNoExt+std::string("_")+std::to_string(t.textureId)+std::string(".png");
-                            simSaveImage(t.image,t.imgRes,1,t.filename.c_str(),-1,nullptr);
-                            size_t ll1=t.filename.find_last_of('/');
-                            size_t ll2=t.filename.find_last_of('\\');
-                            if ( (ll1!=std::string::npos)||(ll2!=std::string::npos) )
-                            {
-                                if (ll1==std::string::npos)
-                                    t.filename.erase(t.filename.begin(),t.filename.begin()+ll2+1);
-                                else
-                                {
-                                    if (ll2==std::string::npos)
-                                        t.filename.erase(t.filename.begin(),t.filename.begin()+ll1+1);
-                                    else
-                                        t.filename.erase(t.filename.begin(),t.filename.begin()+std::max<int>(ll1,ll2)+1);
-                                }
-                            }
-                            allTextures[shapeInfo.textureId]=t;
-                            texturesCnt++;
-                        }
+                        v.sum[k]+=it->second.sum[k];
+                        v.colorSum[k]+=it->second.colorSum[k];
                     }
-                    else
-                        s.textureId=-1;
-                    s.textureCoordinates=shapeInfo.textureCoords;
-                    allShapeComponents.push_back(s);
+                    v.cnt+=it->second.cnt;
                 }
-                res=simGetShapeViz(h,compoundIndex++,&shapeInfo);
             }
+            VoxelMap().swap(bins[t][s]);
         }
-    }
-    if (allShapeComponents.size()==0)
-    {
-        if ((options&256)==0)
+        shardPoints[s].reserve(3*merged.size());
+        if (hasColors)
+            shardColors[s].reserve(3*merged.size());
+        for (VoxelMap::iterator it=merged.begin();it!=merged.end();it++)
         {
-            std::string txt("nothing to export");
-            simAddLog("Assimp",sim_verbosity_errors,txt.c_str());
+            for (size_t k=0;k<3;k++)
+            {
+                shardPoints[s].push_back(it->second.sum[k]/double(it->second.cnt));
+                if (hasColors)
+                    shardColors[s].push_back((unsigned char)(it->second.colorSum[k]/it->second.cnt));
+            }
         }
-        return;
+    });
+    points.clear();
+    colors.clear();
+    for (size_t s=0;s<shardCnt;s++)
+    {
+        points.insert(points.end(),shardPoints[s].begin(),shardPoints[s].end());
+        colors.insert(colors.end(),shardColors[s].begin(),shardColors[s].end());
     }
+}
 
-    aiScene scene;
-    scene.mRootNode=new aiNode();
-    scene.mNumMaterials=allShapeComponents.size();
-    scene.mMaterials=new aiMaterial*[allShapeComponents.size()];
-    scene.mNumMeshes=allShapeComponents.size();
-    scene.mMeshes=new aiMesh*[allShapeComponents.size()];
-    scene.mRootNode->mNumMeshes=allShapeComponents.size();
-    scene.mRootNode->mMeshes=new unsigned int[allShapeComponents.size()];
-    for (size_t shapeCompI=0;shapeCompI<allShapeComponents.size();shapeCompI++)
-    {
-        scene.mMaterials[shapeCompI]=new aiMaterial();
-        scene.mMeshes[shapeCompI]=new aiMesh();
-        scene.mMeshes[shapeCompI]->mMaterialIndex=shapeCompI;
-        scene.mRootNode->mMeshes[shapeCompI]=shapeCompI;
-        auto pMaterial=scene.mMaterials[shapeCompI];
+int assimpImportPointCloud(const char* fileNames,double voxelSize,double scaling,int upVector,int options,double pointSize)
+{
+    std::vector<std::string> filenames;
+    splitString(fileNames,';',filenames);
+    std::vector<double> points;
+    std::vector<unsigned char> colors;
+    bool hasColors=false;
+    for (size_t wi=0;wi<filenames.size();wi++)
+    {
+        if ((options&256)==0)
+        {
+            std::string txt("importing ");
+            txt+=filenames[wi];
+            simAddLog("Assimp",sim_verbosity_infos,txt.c_str());
+        }
+        PooledImporter importer=acquireImporter();
+        int o=options;
+        prepareImporter(*importer,o); // only for the importer properties. No post-processing: points are read as they are
+        const aiScene* scene=importer->ReadFile(filenames[wi].c_str(),0);
+        if (scene)
+        {
+            transformVertices(scene,scaling,upVector);
+            bool hasPointMeshes=false;
+            for (size_t i=0;i<scene->mNumMeshes;i++)
+            {
+                if ((scene->mMeshes[i]->mPrimitiveTypes&aiPrimitiveType_POINT)!=0)
+                    hasPointMeshes=true;
+            }
+            for (size_t i=0;i<scene->mNumMeshes;i++)
+            { // point meshes, or the vertices of all meshes if there are none
+                const aiMesh* mesh=scene->mMeshes[i];
+                if ( hasPointMeshes&&((mesh->mPrimitiveTypes&aiPrimitiveType_POINT)==0) )
+                    continue;
+                size_t off=points.size()/3;
+                points.resize(points.size()+3*mesh->mNumVertices);
+                for (size_t j=0;j<mesh->mNumVertices;j++)
+                {
+                    double* p=&points[3*(off+j)];
+                    if (upVector==1)
+                    {
+                        p[0]=mesh->mVertices[j].x*scaling;
+                        p[1]=mesh->mVertices[j].y*scaling;
+                        p[2]=mesh->mVertices[j].z*scaling;
+                    }
+                    else
+                    {
+                        p[0]=mesh->mVertices[j].x*scaling;
+                        p[1]=-mesh->mVertices[j].z*scaling;
+                        p[2]=mesh->mVertices[j].y*scaling;
+                    }
+                }
+                bool meshColors=( ((options&2)==0)&&mesh->HasVertexColors(0) );
+                if ( meshColors&&(!hasColors) )
+                { // earlier points get the default color
+                    colors.assign(3*off,255);
+                    hasColors=true;
+                }
+                if (hasColors)
+                {
+                    colors.resize(points.size(),255);
+                    if (meshColors)
+                    {
+                        for (size_t j=0;j<mesh->mNumVertices;j++)
+                        {
+                            const aiColor4D& c=mesh->mColors[0][j];
+                            colors[3*(off+j)+0]=(unsigned char)(std::min<float>(std::max<float>(c.r,0.0f),1.0f)*255.0f+0.5f);
+                            colors[3*(off+j)+1]=(unsigned char)(std::min<float>(std::max<float>(c.g,0.0f),1.0f)*255.0f+0.5f);
+                            colors[3*(off+j)+2]=(unsigned char)(std::min<float>(std::max<float>(c.b,0.0f),1.0f)*255.0f+0.5f);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    size_t readCnt=points.size()/3;
+    if (voxelSize>0.0)
+        downsamplePoints(points,colors,voxelSize);
+    if ((options&256)==0)
+    {
+        std::string txt("point cloud: ");
+        txt+=std::to_string(readCnt)+" points read, "+std::to_string(points.size()/3)+" points kept";
+        simAddLog("Assimp",sim_verbosity_infos,txt.c_str());
+    }
+
+    int h=simCreatePointCloud(std::max<double>(0.01,16.0*voxelSize),32,0,pointSize,nullptr);
+    if (filenames.size()>0)
+    {
+        std::string alias(filenames[0]);
+        std::size_t si=alias.find_last_of("/\\");
+        if (si!=std::string::npos)
+            alias=alias.substr(si+1);
+        si=alias.find_last_of(".");
+        if (si!=std::string::npos)
+            alias=alias.substr(0,si);
+        simSetObjectAlias(h,alias.c_str(),0);
+    }
+    const size_t batchSize=262144;
+    for (size_t i=0;i<points.size()/3;i+=batchSize)
+    {
+        int cnt=int(std::min<size_t>(batchSize,points.size()/3-i));
+        simInsertPointsIntoPointCloud(h,hasColors?1:0,&points[3*i],cnt,hasColors?&colors[3*i]:nullptr,nullptr);
+    }
+    return(h);
+}
+
+SIM_DLLEXPORT void simAssimp_importPointCloud(importPointCloud_in *in, importPointCloud_out *out)
+{
+    if(in->voxelSize < 0.0) throw std::runtime_error("invalid voxelSize");
+    if(in->scaling < 0.0) throw std::runtime_error("invalid scaling");
+    if(in->upVector < 0) throw std::runtime_error("invalid upVector");
+    if(in->upVector > 2) throw std::runtime_error("invalid upVector");
+    if(in->options < 0) throw std::runtime_error("invalid options");
+    if(in->pointSize <= 0.0) throw std::runtime_error("invalid pointSize");
+
+    out->pointCloudHandle=assimpImportPointCloud(in->filenames.c_str(),in->voxelSize,in->scaling,parseVectorUp(in->upVector,0),in->options,in->pointSize);
+}
+
+struct SProbeResult
+{
+    int meshCount; // -1 if the file could not be read. All other values are then -1 too
+    int triangleCount;
+    int textureCount;
+    double boundingBox[6];
+    int upVector;
+    double scaling;
+    std::string error;
+};
+
+void assimpProbeFiles(const std::vector<SImportSource>& sources,int options,std::vector<SProbeResult>& results)
+{ // reads the files without any post-processing, in parallel. Nothing is converted, nothing is created
+    results.resize(sources.size());
+    parallelFor(sources.size(),[&](size_t wi)
+    {
+        SProbeResult& r=results[wi];
+        r.meshCount=-1;
+        r.triangleCount=-1;
+        r.textureCount=-1;
+        for (size_t j=0;j<6;j++)
+            r.boundingBox[j]=-1.0;
+        r.upVector=-1;
+        r.scaling=-1.0;
+        PooledImporter importer=acquireImporter();
+        int o=options;
+        prepareImporter(*importer,o); // only for the importer properties
+        const aiScene* scene=readScene(*importer,sources[wi],0);
+        if (scene==nullptr)
+        {
+            r.error=importer->GetErrorString();
+            return;
+        }
+        r.meshCount=int(scene->mNumMeshes);
+        r.triangleCount=0;
+        for (size_t i=0;i<scene->mNumMeshes;i++)
+        { // faces are not triangulated yet: a polygon with n vertices gives n-2 triangles
+            const aiMesh* mesh=scene->mMeshes[i];
+            for (size_t j=0;j<mesh->mNumFaces;j++)
+            {
+                if (mesh->mFaces[j].mNumIndices>=3)
+                    r.triangleCount+=int(mesh->mFaces[j].mNumIndices)-2;
+            }
+        }
+        std::unordered_set<std::string> textures;
+        for (size_t i=0;i<scene->mNumMaterials;i++)
+        { // same texture lookup as the import
+            aiString texPath;
+            if (aiReturn_SUCCESS==aiGetMaterialTexture(scene->mMaterials[i],aiTextureType_DIFFUSE,0,&texPath))
+                textures.insert(texPath.C_Str());
+        }
+        r.textureCount=int(textures.size());
+        r.upVector=0;
+        r.scaling=0.0;
+        transformVertices(scene,r.scaling,r.upVector,r.boundingBox); // scaling and up-vector as the import would pick them automatically
+        importer->FreeScene();
+    });
+}
+
+SIM_DLLEXPORT void simAssimp_probeFiles(probeFiles_in *in, probeFiles_out *out)
+{
+    if(in->options < 0) throw std::runtime_error("invalid options");
+
+    std::vector<SImportSource> sources=getFileSources(in->filenames.c_str());
+    std::vector<SProbeResult> results;
+    assimpProbeFiles(sources,in->options,results);
+    for (size_t i=0;i<results.size();i++)
+    {
+        const SProbeResult& r=results[i];
+        if ( ((in->options&256)==0)&&(r.meshCount<0) )
+        {
+            std::string txt("failed probing ");
+            txt+=sources[i].name+": "+r.error;
+            simAddLog("Assimp",sim_verbosity_warnings,txt.c_str());
+        }
+        out->meshCounts.push_back(r.meshCount);
+        out->triangleCounts.push_back(r.triangleCount);
+        out->textureCounts.push_back(r.textureCount);
+        for (size_t j=0;j<6;j++)
+            out->boundingBoxes.push_back(r.boundingBox[j]);
+        out->upVectors.push_back(r.upVector);
+        out->scalings.push_back(r.scaling);
+    }
+}
+
+struct SExportedFile
+{ // one file of an export to memory. The first one is the main file, the others are e.g. material files
+    std::string name;
+    std::string data;
+};
+
+bool exportScene(Assimp::Exporter& exporter,const aiScene* scene,const char* format,const char* filename,std::vector<SExportedFile>* files)
+{ // exports to filename, or to memory if files is not null
+    if (files==nullptr)
+        return(exporter.Export(scene,format,filename)==aiReturn_SUCCESS);
+    const aiExportDataBlob* blob=exporter.ExportToBlob(scene,format);
+    if (blob==nullptr)
+        return(false);
+    while (blob!=nullptr)
+    {
+        SExportedFile f;
+        f.name=blob->name.C_Str();
+        f.data.assign((const char*)blob->data,blob->size);
+        files->push_back(f);
+        blob=blob->next;
+    }
+    exporter.FreeBlob();
+    return(true);
+}
+
+void appendPngChunk(std::string& png,const char* type,const std::string& data)
+{ // length, type, data, and the CRC-32 of type and data
+    uint32_t l=uint32_t(data.size());
+    uLong crc=crc32(0L,(const Bytef*)type,4);
+    if (l>0)
+        crc=crc32(crc,(const Bytef*)data.data(),uInt(l));
+    const unsigned char header[4]={(unsigned char)(l>>24),(unsigned char)(l>>16),(unsigned char)(l>>8),(unsigned char)l};
+    const unsigned char footer[4]={(unsigned char)(crc>>24),(unsigned char)(crc>>16),(unsigned char)(crc>>8),(unsigned char)crc};
+    png.append((const char*)header,4);
+    png.append(type,4);
+    png+=data;
+    png.append((const char*)footer,4);
+}
+
+bool encodePng(const unsigned char* image,const int* res,std::string& png)
+{ // RGBA, rows in buffer order. Rows use the Paeth filter, then are deflated with zlib
+    if ( (res[0]<=0)||(res[1]<=0) )
+        return(false);
+    size_t rowSize=4*size_t(res[0]);
+    std::vector<unsigned char> raw((rowSize+1)*res[1]);
+    for (int y=0;y<res[1];y++)
+    {
+        const unsigned char* row=image+rowSize*y;
+        const unsigned char* prev=(y>0)?row-rowSize:nullptr;
+        unsigned char* dest=raw.data()+(rowSize+1)*y;
+        dest[0]=4; // Paeth
+        for (size_t x=0;x<rowSize;x++)
+        {
+            int a=(x>=4)?row[x-4]:0;
+            int b=(prev!=nullptr)?prev[x]:0;
+            int c=( (x>=4)&&(prev!=nullptr) )?prev[x-4]:0;
+            int p=a+b-c;
+            int pa=abs(p-a);
+            int pb=abs(p-b);
+            int pc=abs(p-c);
+            int pred=( (pa<=pb)&&(pa<=pc) )?a:((pb<=pc)?b:c);
+            dest[1+x]=(unsigned char)(row[x]-pred);
+        }
+    }
+    uLongf zSize=compressBound(uLong(raw.size()));
+    std::string z(zSize,'\0');
+    if (compress2((Bytef*)&z[0],&zSize,raw.data(),uLong(raw.size()),Z_DEFAULT_COMPRESSION)!=Z_OK)
+        return(false);
+    z.resize(zSize);
+
+    std::string ihdr;
+    const uint32_t dims[2]={uint32_t(res[0]),uint32_t(res[1])};
+    for (size_t i=0;i<2;i++)
+    {
+        ihdr.push_back(char(dims[i]>>24));
+        ihdr.push_back(char(dims[i]>>16));
+        ihdr.push_back(char(dims[i]>>8));
+        ihdr.push_back(char(dims[i]));
+    }
+    const char ihdrTail[5]={8,6,0,0,0}; // 8-bit, RGBA (colour type 6), deflate, adaptive filtering, no interlace
+    ihdr.append(ihdrTail,5);
+    png.assign("\x89PNG\r\n\x1a\n",8);
+    appendPngChunk(png,"IHDR",ihdr);
+    appendPngChunk(png,"IDAT",z);
+    appendPngChunk(png,"IEND",std::string());
+    return(true);
+}
+
+aiTexture* createEmbeddedTexture(const std::string& data,const char* formatHint)
+{ // a compressed texture (e.g. PNG), embedded in the scene
+    aiTexture* texture=new aiTexture();
+    texture->mHeight=0;
+    texture->mWidth=(unsigned int)data.size();
+    texture->pcData=new aiTexel[(data.size()+sizeof(aiTexel)-1)/sizeof(aiTexel)];
+    memcpy(texture->pcData,data.data(),data.size());
+    strncpy(texture->achFormatHint,formatHint,sizeof(texture->achFormatHint)-1);
+    texture->achFormatHint[sizeof(texture->achFormatHint)-1]=0;
+    return(texture);
+}
+
+struct SExportComponent
+{ // a shape component to be exported. Once transformed, vertices are duplicated per index, unless normals and textures are both dropped
+    std::vector<double> vertices;
+    std::vector<int> indices;
+    std::vector<double> normals; // 3 per index
+    double colorAD[3];
+    double colorS[3];
+    double colorE[3];
+    int textureId; // -1 for none
+    std::vector<float> textureCoordinates; // 2 per index
+};
+
+struct SExportTexture
+{
+    int imgRes[2];
+    std::vector<unsigned char> image; // RGBA
+    std::string filename; // as referenced by the material, i.e. without path, or "*index" if embedded
+};
+
+bool getExportPose(int shapeHandle,C7Vector& tr)
+{ // tr is the identity if the pose cannot be read (e.g. the shape was removed)
+    tr.setIdentity();
+    double p[3];
+    double q[4];
+    if ( (simGetObjectPosition(shapeHandle,-1,p)==-1)||(simGetObjectQuaternion(shapeHandle,-1,q)==-1) )
+        return(false);
+    tr.X=C3Vector(p);
+    tr.Q=C4Vector(q[3],q[0],q[1],q[2]);
+    return(true);
+}
+
+void extractShapeComponents(int shapeHandle,int options,std::vector<SExportComponent>& components,std::map<int,SExportTexture>& textures)
+{ // reads the visual components of a shape, in the shape's frame. Textures not yet in textures are added
+    int compoundIndex=0;
+    SShapeVizInfo shapeInfo;
+    int res=simGetShapeViz(shapeHandle,compoundIndex++,&shapeInfo);
+    while (res>0)
+    {
+        if ((shapeInfo.textureOptions&8)==0)
+        { // component is not wireframe (we ignore wireframe components)
+            SExportComponent s; // as is: duplicating vertices is left to transformComponent, that can run in parallel
+            s.vertices.assign(shapeInfo.vertices,shapeInfo.vertices+shapeInfo.verticesSize);
+            s.indices.assign(shapeInfo.indices,shapeInfo.indices+shapeInfo.indicesSize);
+            if ((options&4)==0)
+                s.normals.assign(shapeInfo.normals,shapeInfo.normals+3*shapeInfo.indicesSize);
+            for (size_t i=0;i<3;i++)
+            {
+                s.colorAD[i]=shapeInfo.colors[0+i];
+                s.colorS[i]=shapeInfo.colors[3+i];
+                s.colorE[i]=shapeInfo.colors[6+i];
+            }
+            s.textureId=-1;
+            if ( (shapeInfo.texture!=nullptr)&&((options&1)==0) )
+            {
+                s.textureId=shapeInfo.textureId;
+                if (textures.find(s.textureId)==textures.end())
+                {
+                    SExportTexture& t=textures[s.textureId];
+                    t.imgRes[0]=shapeInfo.textureRes[0];
+                    t.imgRes[1]=shapeInfo.textureRes[1];
+                    t.image.assign((unsigned char*)shapeInfo.texture,(unsigned char*)shapeInfo.texture+4*t.imgRes[0]*t.imgRes[1]);
+                }
+                if (shapeInfo.textureCoords!=nullptr)
+                    s.textureCoordinates.assign(shapeInfo.textureCoords,shapeInfo.textureCoords+2*shapeInfo.indicesSize);
+            }
+            components.push_back(s);
+        }
+        simReleaseBuffer((char*)shapeInfo.vertices);
+        simReleaseBuffer((char*)shapeInfo.indices);
+        simReleaseBuffer((char*)shapeInfo.normals);
+        simReleaseBuffer((char*)shapeInfo.textureCoords);
+        simReleaseBuffer((char*)shapeInfo.texture);
+        res=simGetShapeViz(shapeHandle,compoundIndex++,&shapeInfo);
+    }
+}
+
+void transformComponent(const SExportComponent& local,const C7Vector& tr,double scaling,int upVector,int options,SExportComponent& world)
+{ // from the shape frame to the exported frame, i.e. scaled, and y-up if upVector is 2. Does not call the sim API
+    for (size_t i=0;i<3;i++)
+    {
+        world.colorAD[i]=local.colorAD[i];
+        world.colorS[i]=local.colorS[i];
+        world.colorE[i]=local.colorE[i];
+    }
+    world.textureId=local.textureId;
+    world.textureCoordinates=local.textureCoordinates;
+    if ((options&5)==5)
+    { // we drop textures and normals
+        world.vertices=local.vertices;
+        world.indices=local.indices;
+    }
+    else
+    { // we keep normals and/or textures. We need to duplicate vertices:
+        world.vertices.resize(3*local.indices.size());
+        world.indices.resize(local.indices.size());
+        for (size_t i=0;i<local.indices.size();i++)
+        {
+            world.vertices[3*i+0]=local.vertices[3*local.indices[i]+0];
+            world.vertices[3*i+1]=local.vertices[3*local.indices[i]+1];
+            world.vertices[3*i+2]=local.vertices[3*local.indices[i]+2];
+            world.indices[i]=int(i);
+        }
+    }
+    for (size_t i=0;i<world.vertices.size()/3;i++)
+    {
+        C3Vector v(&world.vertices[3*i]);
+        v=tr*v;
+        if (upVector==1)
+        {
+            world.vertices[3*i+0]=v(0)*scaling;
+            world.vertices[3*i+1]=v(1)*scaling;
+            world.vertices[3*i+2]=v(2)*scaling;
+        }
+        else
+        {
+            world.vertices[3*i+0]=v(0)*scaling;
+            world.vertices[3*i+1]=v(2)*scaling;
+            world.vertices[3*i+2]=-v(1)*scaling;
+        }
+    }
+    world.normals.clear();
+    if ((options&4)!=0)
+        return; // normals are dropped
+    world.normals=local.normals;
+    for (size_t i=0;i<world.normals.size()/3;i++)
+    {
+        C3Vector v(&world.normals[3*i]);
+        v=tr.Q*v;
+        if (upVector==1)
+        {
+            world.normals[3*i+0]=v(0);
+            world.normals[3*i+1]=v(1);
+            world.normals[3*i+2]=v(2);
+        }
+        else
+        { // same axis swap as for the vertices
+            world.normals[3*i+0]=v(0);
+            world.normals[3*i+1]=v(2);
+            world.normals[3*i+2]=-v(1);
+        }
+    }
+}
+
+std::string getTextureFilename(const char* filename,int textureId)
+{ // the file a texture is saved to, next to the exported file
+    std::string filenameNoExt(filename);
+    size_t ll=filenameNoExt.find_last_of('.');
+    if (ll!=std::string::npos)
+        filenameNoExt.resize(ll);
+    return(filenameNoExt+std::string("_")+std::to_string(textureId)+std::string(".png"));
+}
+
+std::string stripPath(const std::string& filename)
+{
+    size_t ll=filename.find_last_of("/\\");
+    if (ll==std::string::npos)
+        return(filename);
+    return(filename.substr(ll+1));
+}
+
+void allocateExportScene(aiScene& scene,size_t componentCnt,std::vector<aiTexture*>& embeddedTextures)
+{ // one mesh and one material per component. The node hierarchy is left to the caller. The scene takes ownership of the embedded textures
+    scene.mNumMaterials=(unsigned int)componentCnt;
+    scene.mMaterials=new aiMaterial*[componentCnt](); // null until filled, the scene can be released at any time
+    scene.mNumMeshes=(unsigned int)componentCnt;
+    scene.mMeshes=new aiMesh*[componentCnt]();
+    if (embeddedTextures.size()>0)
+    {
+        scene.mNumTextures=(unsigned int)embeddedTextures.size();
+        scene.mTextures=new aiTexture*[embeddedTextures.size()];
+        for (size_t i=0;i<embeddedTextures.size();i++)
+            scene.mTextures[i]=embeddedTextures[i];
+        embeddedTextures.clear();
+    }
+}
+
+void fillExportMesh(aiScene& scene,size_t shapeCompI,const SExportComponent& comp,const std::map<int,SExportTexture>& textures,int options)
+{ // fills mesh and material shapeCompI. Does not call the sim API
+    scene.mMaterials[shapeCompI]=new aiMaterial();
+    scene.mMeshes[shapeCompI]=new aiMesh();
+    scene.mMeshes[shapeCompI]->mMaterialIndex=shapeCompI;
+    auto pMaterial=scene.mMaterials[shapeCompI];
+    if ((options&2)==0)
+    {
+        aiColor3D colorAD(comp.colorAD[0],comp.colorAD[1],comp.colorAD[2]);
+        pMaterial->AddProperty(&colorAD,3,AI_MATKEY_COLOR_AMBIENT);
+        pMaterial->AddProperty(&colorAD,3,AI_MATKEY_COLOR_DIFFUSE);
+        aiColor3D colorS(comp.colorS[0],comp.colorS[1],comp.colorS[2]);
+        pMaterial->AddProperty(&colorS,3,AI_MATKEY_COLOR_SPECULAR);
+        aiColor3D colorE(comp.colorE[0],comp.colorE[1],comp.colorE[2]);
+        pMaterial->AddProperty(&colorE,3,AI_MATKEY_COLOR_EMISSIVE);
+    }
+
+    auto pMesh=scene.mMeshes[shapeCompI];
+
+    pMesh->mVertices=new aiVector3D[comp.vertices.size()/3];
+    pMesh->mNumVertices=comp.vertices.size()/3;
+    for (size_t i=0;i<comp.vertices.size()/3;i++)
+    {
+        const double* v=comp.vertices.data();
+        pMesh->mVertices[i]=aiVector3D(v[3*i+0],v[3*i+1],v[3*i+2]);
+    }
+
+    if ((options&4)==0)
+    {
+        pMesh->mNormals=new aiVector3D[comp.indices.size()];
+        for (size_t i=0;i<comp.indices.size();i++)
+        {
+            const double* n=comp.normals.data();
+            pMesh->mNormals[i]=aiVector3D(n[3*i+0],n[3*i+1],n[3*i+2]);
+        }
+    }
+
+    pMesh->mFaces=new aiFace[comp.indices.size()/3];
+    pMesh->mNumFaces=comp.indices.size()/3;
+    for (size_t i=0;i<comp.indices.size()/3;i++)
+    {
+        const int* tri=comp.indices.data();
+        aiFace& face=pMesh->mFaces[i];
+        face.mIndices=new unsigned int[3];
+        face.mNumIndices=3;
+        face.mIndices[0]=tri[3*i+0];
+        face.mIndices[1]=tri[3*i+1];
+        face.mIndices[2]=tri[3*i+2];
+    }
+
+    if ( (comp.textureCoordinates.size()>0)&&((options&1)==0) )
+    {
+        pMesh->mTextureCoords[0]=new aiVector3D[comp.vertices.size()/3];
+        pMesh->mNumUVComponents[0]=comp.vertices.size()/3;
+        for (size_t i=0;i<comp.indices.size()/3;i++)
+        {
+            const int* tri=comp.indices.data();
+            int index[3]={tri[3*i+0],tri[3*i+1],tri[3*i+2]};
+            const float* tCoords=comp.textureCoordinates.data();
+            pMesh->mTextureCoords[0][index[0]]=aiVector3D((double)tCoords[6*i+0],(double)tCoords[6*i+1],0.0);
+            pMesh->mTextureCoords[0][index[1]]=aiVector3D((double)tCoords[6*i+2],(double)tCoords[6*i+3],0.0);
+            pMesh->mTextureCoords[0][index[2]]=aiVector3D((double)tCoords[6*i+4],(double)tCoords[6*i+5],0.0);
+        }
+        std::map<int,SExportTexture>::const_iterator textIt=textures.find(comp.textureId);
+        if ( (textIt!=textures.end())&&(textIt->second.filename.size()>0) )
+        {
+            aiString filePath(textIt->second.filename);
+            pMaterial->AddProperty(&filePath,AI_MATKEY_TEXTURE_DIFFUSE(0));
+        }
+    }
+    else
+    {
+        pMesh->mTextureCoords[0]=nullptr;
+        pMesh->mNumUVComponents[0]=0;
+    }
+}
+
+void fillExportScene(aiScene& scene,const std::vector<const SExportComponent*>& components,const std::map<int,SExportTexture>& textures,std::vector<aiTexture*>& embeddedTextures,int options)
+{
+    allocateExportScene(scene,components.size(),embeddedTextures);
+    for (size_t i=0;i<components.size();i++)
+        fillExportMesh(scene,i,components[i][0],textures,options);
+}
+
+void setFlatRootNode(aiScene& scene)
+{ // all meshes in the root node
+    scene.mRootNode=new aiNode();
+    scene.mRootNode->mNumMeshes=scene.mNumMeshes;
+    scene.mRootNode->mMeshes=new unsigned int[scene.mNumMeshes];
+    for (unsigned int i=0;i<scene.mNumMeshes;i++)
+        scene.mRootNode->mMeshes[i]=i;
+}
+
+bool exportComponents(const std::vector<const SExportComponent*>& components,const std::map<int,SExportTexture>& textures,std::vector<aiTexture*>& embeddedTextures,const char* filename,const char* format,int options,std::vector<SExportedFile>* files)
+{ // builds a flat scene and exports it
+    aiScene scene;
+    fillExportScene(scene,components,textures,embeddedTextures,options);
+    setFlatRootNode(scene);
+
+    PooledExporter exporter=acquireExporter();
+    return(exportScene(*exporter,&scene,format,filename,files));
+}
+
+struct SExportJob
+{ // the sim data of one exported file, gathered on the simulation thread, so that the rest can run on a worker
+    std::string filename;
+    std::string format;
+    std::vector<SExportComponent> components; // in the shape frames
+    std::vector<C7Vector> transforms; // one per component
+    std::map<int,SExportTexture> textures;
+    bool ok;
+    std::string error;
+};
+
+void gatherExportJob(const int* shapeHandles,size_t shapeCnt,int options,SExportJob& job)
+{
+    C7Vector firstTrInv;
+    for (size_t shapeI=0;shapeI<shapeCnt;shapeI++)
+    {
+        int h=shapeHandles[shapeI];
+        C7Vector tr;
+        getExportPose(h,tr);
+        if (shapeI==0)
+            firstTrInv=tr.getInverse();
+        if ((options&512)!=0)
+            tr=firstTrInv*tr;
+        int visible;
+        simGetObjectInt32Param(h,sim_objintparam_visible,&visible);
+        if ( ((options&8)==0)||(visible!=0) )
+        {
+            extractShapeComponents(h,options,job.components,job.textures);
+            job.transforms.resize(job.components.size(),tr);
+        }
+    }
+    for (std::map<int,SExportTexture>::iterator textIt=job.textures.begin();textIt!=job.textures.end();textIt++)
+        textIt->second.filename=stripPath(getTextureFilename(job.filename.c_str(),textIt->first));
+}
+
+bool assimpExportShapes(const std::vector<int>& shapeHandles,const char* filename,const char* format,double scaling,int upVector,int options,std::vector<SExportedFile>* files=nullptr)
+{ // with files not null, exports to memory, and textures are embedded
+    if ((options&256)==0)
+    {
+        std::string txt("exporting ");
+        if (files==nullptr)
+            txt+=filename;
+        else
+            txt+="to memory";
+        simAddLog("Assimp",sim_verbosity_infos,txt.c_str());
+    }
+
+    // 1. Serial stage: read the sim data
+    SExportJob job;
+    job.filename=filename;
+    gatherExportJob(shapeHandles.data(),shapeHandles.size(),options,job);
+    if (job.components.size()==0)
+    {
+        if ((options&256)==0)
+        {
+            std::string txt("nothing to export");
+            simAddLog("Assimp",sim_verbosity_errors,txt.c_str());
+        }
+        return(false);
+    }
+    std::vector<aiTexture*> embeddedTextures;
+    if (files!=nullptr)
+    { // embedded textures must be known before the materials are filled
+        for (std::map<int,SExportTexture>::iterator textIt=job.textures.begin();textIt!=job.textures.end();textIt++)
+        {
+            std::string png;
+            textIt->second.filename.clear();
+            if (encodePng(textIt->second.image.data(),textIt->second.imgRes,png))
+            {
+                textIt->second.filename="*"+std::to_string(embeddedTextures.size());
+                embeddedTextures.push_back(createEmbeddedTexture(png,"png"));
+            }
+        }
+    }
+
+    // 2. Parallel stage: transform and fill the meshes, component by component. When exporting to a file,
+    // the simulation thread meanwhile saves the textures
+    aiScene scene;
+    allocateExportScene(scene,job.components.size(),embeddedTextures);
+    std::exception_ptr error;
+    std::thread workers([&]()
+    {
+        try
+        {
+            parallelFor(job.components.size(),[&](size_t i)
+            {
+                SExportComponent comp;
+                transformComponent(job.components[i],job.transforms[i],scaling,upVector,options,comp);
+                fillExportMesh(scene,i,comp,job.textures,options);
+            });
+        }
+        catch(...)
+        {
+            error=std::current_exception();
+        }
+    });
+    if (files==nullptr)
+    {
+        for (std::map<int,SExportTexture>::const_iterator textIt=job.textures.begin();textIt!=job.textures.end();textIt++)
+        {
+            std::string fn(getTextureFilename(filename,textIt->first));
+            simSaveImage(textIt->second.image.data(),textIt->second.imgRes,1,fn.c_str(),-1,nullptr);
+        }
+    }
+    workers.join();
+    if (error)
+        std::rethrow_exception(error);
+    setFlatRootNode(scene);
+
+    PooledExporter exporter=acquireExporter();
+    return(exportScene(*exporter,&scene,format,filename,files));
+}
+
+
+SIM_DLLEXPORT void simAssimp_exportShapes(exportShapes_in *in, exportShapes_out *out)
+{
+    bool formatOk=(exportFormatsById.find(in->formatId)!=exportFormatsById.end());
+
+    if (in->shapeHandles.size()<1) throw std::runtime_error("invalid shapeHandles");
+    if(!formatOk) throw std::runtime_error("invalid format");
+    if(in->scaling < 0.001) throw std::runtime_error("invalid scaling");
+    if(in->upVector < 1) throw std::runtime_error("invalid upVector");
+    if(in->upVector > 2) throw std::runtime_error("invalid upVector");
+    if(in->options < 0) throw std::runtime_error("invalid options");
+
+    assimpExportShapes(in->shapeHandles,in->filename.c_str(),in->formatId.c_str(),in->scaling,parseVectorUp(in->upVector,0),in->options);
+}
+
+SIM_DLLEXPORT void simAssimp_exportShapesToBuffer(exportShapesToBuffer_in *in, exportShapesToBuffer_out *out)
+{
+    if (in->shapeHandles.size()<1) throw std::runtime_error("invalid shapeHandles");
+    if(exportFormatsById.find(in->formatId)==exportFormatsById.end()) throw std::runtime_error("invalid format");
+    if(in->scaling < 0.001) throw std::runtime_error("invalid scaling");
+    if(in->upVector < 1) throw std::runtime_error("invalid upVector");
+    if(in->upVector > 2) throw std::runtime_error("invalid upVector");
+    if(in->options < 0) throw std::runtime_error("invalid options");
+
+    std::vector<SExportedFile> files;
+    if (!assimpExportShapes(in->shapeHandles,"",in->formatId.c_str(),in->scaling,parseVectorUp(in->upVector,0),in->options,&files))
+        throw std::runtime_error("export failed");
+    out->data=files[0].data;
+    for (size_t i=1;i<files.size();i++)
+    {
+        out->auxFileNames.push_back(files[i].name);
+        out->auxFileData.push_back(files[i].data);
+    }
+}
+
+void runExportJob(SExportJob& job,double scaling,int upVector,int options)
+{ // no sim API calls here: textures are saved separately
+    job.ok=false;
+    if (job.components.size()==0)
+    {
+        job.error="nothing to export";
+        return;
+    }
+    std::vector<SExportComponent> transformed(job.components.size());
+    std::vector<const SExportComponent*> components;
+    for (size_t i=0;i<job.components.size();i++)
+    {
+        transformComponent(job.components[i],job.transforms[i],scaling,upVector,options,transformed[i]);
+        components.push_back(&transformed[i]);
+    }
+    std::vector<aiTexture*> embeddedTextures;
+    job.ok=exportComponents(components,job.textures,embeddedTextures,job.filename.c_str(),job.format.c_str(),options,nullptr);
+    if (!job.ok)
+        job.error="export failed";
+}
+
+void assimpExportShapesBatch(std::vector<SExportJob>& jobs,const std::vector<const int*>& shapeHandles,const std::vector<int>& shapeCounts,double scaling,int upVector,int options)
+{
+    for (size_t i=0;i<jobs.size();i++)
+        gatherExportJob(shapeHandles[i],shapeCounts[i],options,jobs[i]);
+
+    // Scenes are built and serialized on workers, while the simulation thread saves the textures
+    std::exception_ptr error;
+    std::thread workers([&]()
+    {
+        try
+        {
+            parallelFor(jobs.size(),[&](size_t i)
+            {
+                runExportJob(jobs[i],scaling,upVector,options);
+            });
+        }
+        catch(...)
+        {
+            error=std::current_exception();
+        }
+    });
+    for (size_t i=0;i<jobs.size();i++)
+    {
+        for (std::map<int,SExportTexture>::const_iterator textIt=jobs[i].textures.begin();textIt!=jobs[i].textures.end();textIt++)
+        {
+            std::string fn(getTextureFilename(jobs[i].filename.c_str(),textIt->first));
+            simSaveImage(textIt->second.image.data(),textIt->second.imgRes,1,fn.c_str(),-1,nullptr);
+        }
+    }
+    workers.join();
+    if (error)
+        std::rethrow_exception(error);
+
+    if ((options&256)==0)
+    {
+        for (size_t i=0;i<jobs.size();i++)
+        {
+            if (jobs[i].ok)
+            {
+                std::string txt("exported "+jobs[i].filename);
+                simAddLog("Assimp",sim_verbosity_infos,txt.c_str());
+            }
+            else
+            {
+                std::string txt("failed exporting "+jobs[i].filename+": "+jobs[i].error);
+                simAddLog("Assimp",sim_verbosity_errors,txt.c_str());
+            }
+        }
+    }
+}
+
+SIM_DLLEXPORT void simAssimp_exportShapesBatch(exportShapesBatch_in *in, exportShapesBatch_out *out)
+{
+    if (in->jobSizes.size()<1) throw std::runtime_error("invalid jobSizes");
+    if (in->filenames.size()!=in->jobSizes.size()) throw std::runtime_error("invalid filenames");
+    if ( (in->formatIds.size()!=1)&&(in->formatIds.size()!=in->jobSizes.size()) ) throw std::runtime_error("invalid formatIds");
+    for (size_t i=0;i<in->formatIds.size();i++)
+    {
+        if(exportFormatsById.find(in->formatIds[i])==exportFormatsById.end()) throw std::runtime_error("invalid format");
+    }
+    if(in->scaling < 0.001) throw std::runtime_error("invalid scaling");
+    if(in->upVector < 1) throw std::runtime_error("invalid upVector");
+    if(in->upVector > 2) throw std::runtime_error("invalid upVector");
+    if(in->options < 0) throw std::runtime_error("invalid options");
+
+    std::vector<SExportJob> jobs(in->jobSizes.size());
+    std::vector<const int*> shapeHandles;
+    std::vector<int> shapeCounts;
+    size_t off=0;
+    for (size_t i=0;i<jobs.size();i++)
+    {
+        if ( (in->jobSizes[i]<1)||(off+in->jobSizes[i]>in->shapeHandles.size()) ) throw std::runtime_error("invalid jobSizes");
+        jobs[i].filename=in->filenames[i];
+        jobs[i].format=in->formatIds[in->formatIds.size()==1?0:i];
+        shapeHandles.push_back(in->shapeHandles.data()+off);
+        shapeCounts.push_back(in->jobSizes[i]);
+        off+=in->jobSizes[i];
+    }
+    if (off!=in->shapeHandles.size()) throw std::runtime_error("invalid jobSizes");
+
+    assimpExportShapesBatch(jobs,shapeHandles,shapeCounts,in->scaling,parseVectorUp(in->upVector,0),in->options);
+    for (size_t i=0;i<jobs.size();i++)
+        out->statuses.push_back(jobs[i].ok);
+}
+
+// Compact export: positions, normals and texture coordinates are snapped to a grid, then identical vertices are
+// merged into indexed buffers. Components with identical materials are merged into a single mesh, identical
+// textures are stored once, downscaled and embedded
+struct SCompactVertexKey
+{
+    long long v[8]; // quantized position, normal and texture coordinates
+    bool operator==(const SCompactVertexKey& o) const
+    {
+        return(memcmp(v,o.v,sizeof(v))==0);
+    }
+};
+
+struct SCompactVertexKeyHash
+{
+    size_t operator()(const SCompactVertexKey& k) const
+    {
+        size_t h=0;
+        for (size_t i=0;i<8;i++)
+            h=h*1000003u^std::hash<long long>()(k.v[i]);
+        return(h);
+    }
+};
+
+struct SCompactMesh
+{
+    std::vector<double> vertices;
+    std::vector<double> normals; // one per vertex, or empty
+    std::vector<float> textureCoords; // 2 per vertex, or empty
+    std::vector<int> indices;
+    size_t materialIndex;
+    std::unordered_map<SCompactVertexKey,int,SCompactVertexKeyHash> vertexMap; // shared by all components of the mesh, so that they weld together
+};
+
+long long quantize(double v,double offset,double step)
+{
+    return((long long)std::floor((v-offset)/step+0.5));
+}
+
+void appendCompactComponent(const SExportComponent& comp,const double* bbMin,double positionStep,double normalSteps,double uvSteps,int options,SCompactMesh& mesh)
+{ // comp is transformed, i.e. de-indexed unless normals and textures are both dropped
+    bool hasNormals=((options&4)==0)&&(comp.normals.size()>0);
+    bool hasUvs=(comp.textureCoordinates.size()>0);
+    std::unordered_map<SCompactVertexKey,int,SCompactVertexKeyHash>& vertexMap=mesh.vertexMap;
+    for (size_t i=0;i<comp.indices.size();i++)
+    {
+        int vi=comp.indices[i];
+        SCompactVertexKey k;
+        memset(k.v,0,sizeof(k.v));
+        for (size_t j=0;j<3;j++)
+            k.v[j]=quantize(comp.vertices[3*vi+j],bbMin[j],positionStep);
+        double n[3]={0.0,0.0,0.0};
+        if (hasNormals)
+        { // normals are given per index
+            double l=0.0;
+            for (size_t j=0;j<3;j++)
+            {
+                k.v[3+j]=quantize(comp.normals[3*i+j],0.0,1.0/normalSteps);
+                n[j]=double(k.v[3+j])/normalSteps;
+                l+=n[j]*n[j];
+            }
+            l=sqrt(l);
+            if (l>0.0)
+            {
+                for (size_t j=0;j<3;j++)
+                    n[j]/=l;
+            }
+        }
+        if (hasUvs)
+        { // texture coordinates are given per index, as 6 values per triangle
+            k.v[6]=quantize(comp.textureCoordinates[2*i+0],0.0,1.0/uvSteps);
+            k.v[7]=quantize(comp.textureCoordinates[2*i+1],0.0,1.0/uvSteps);
+        }
+        std::unordered_map<SCompactVertexKey,int,SCompactVertexKeyHash>::iterator it=vertexMap.find(k);
+        if (it==vertexMap.end())
+        {
+            int index=int(mesh.vertices.size()/3);
+            it=vertexMap.insert(std::make_pair(k,index)).first;
+            for (size_t j=0;j<3;j++)
+                mesh.vertices.push_back(bbMin[j]+double(k.v[j])*positionStep);
+            if (hasNormals)
+                mesh.normals.insert(mesh.normals.end(),n,n+3);
+            if (hasUvs)
+            {
+                mesh.textureCoords.push_back(float(double(k.v[6])/uvSteps));
+                mesh.textureCoords.push_back(float(double(k.v[7])/uvSteps));
+            }
+        }
+        mesh.indices.push_back(it->second);
+    }
+    // drop triangles that collapsed through quantization
+    size_t triStart=mesh.indices.size()-comp.indices.size();
+    size_t w=triStart;
+    for (size_t i=triStart;i<mesh.indices.size();i+=3)
+    {
+        int a=mesh.indices[i+0];
+        int b=mesh.indices[i+1];
+        int c=mesh.indices[i+2];
+        if ( (a!=b)&&(b!=c)&&(c!=a) )
+        {
+            mesh.indices[w++]=a;
+            mesh.indices[w++]=b;
+            mesh.indices[w++]=c;
+        }
+    }
+    mesh.indices.resize(w);
+}
+
+bool assimpExportShapesCompact(const std::vector<int>& shapeHandles,const char* filename,double scaling,int upVector,int options,int maxTextureSize,int positionBits,int normalBits,int uvBits)
+{
+    if ((options&256)==0)
+    {
+        std::string txt("exporting ");
+        txt+=filename;
+        simAddLog("Assimp",sim_verbosity_infos,txt.c_str());
+    }
+    SExportJob job;
+    job.filename=filename;
+    gatherExportJob(shapeHandles.data(),shapeHandles.size(),options,job);
+    if (job.components.size()==0)
+    {
+        if ((options&256)==0)
+            simAddLog("Assimp",sim_verbosity_errors,"nothing to export");
+        return(false);
+    }
+
+    // Textures: identical images are kept once, then downscaled and embedded
+    std::map<int,int> textureIndices; // texture id --> embedded texture index
+    std::vector<aiTexture*> embeddedTextures;
+    std::unordered_multimap<size_t,std::pair<const SExportTexture*,int>> uniqueImages; // hash --> texture and its embedded index
+    for (std::map<int,SExportTexture>::iterator textIt=job.textures.begin();textIt!=job.textures.end();textIt++)
+    {
+        SExportTexture& t=textIt->second;
+        size_t hash=std::hash<std::string_view>()(std::string_view((const char*)t.image.data(),t.image.size()));
+        hash^=(size_t(t.imgRes[0])*73856093u)^(size_t(t.imgRes[1])*19349663u); // same bytes with different resolutions are different images
+        int found=-2;
+        auto range=uniqueImages.equal_range(hash);
+        for (auto it=range.first;it!=range.second;it++)
+        { // confirm the match
+            const SExportTexture* o=it->second.first;
+            if ( (o->imgRes[0]==t.imgRes[0])&&(o->imgRes[1]==t.imgRes[1])&&(o->image.size()==t.image.size())&&(memcmp(o->image.data(),t.image.data(),t.image.size())==0) )
+            {
+                found=it->second.second;
+                break;
+            }
+        }
+        if (found!=-2)
+        {
+            textureIndices[textIt->first]=found;
+            continue;
+        }
+        const unsigned char* img=t.image.data();
+        int res[2]={t.imgRes[0],t.imgRes[1]};
+        int resOut[2];
+        std::vector<unsigned char> scaled;
+        if (scaleTexture(img,res,maxTextureSize,resample_target_aspect,scaled,resOut))
+        {
+            img=scaled.data();
+            res[0]=resOut[0];
+            res[1]=resOut[1];
+        }
+        std::string png;
+        int index=-1;
+        if (encodePng(img,res,png))
+        {
+            index=int(embeddedTextures.size());
+            embeddedTextures.push_back(createEmbeddedTexture(png,"png"));
+        }
+        uniqueImages.insert(std::make_pair(hash,std::make_pair(&t,index)));
+        textureIndices[textIt->first]=index;
+    }
+
+    std::vector<SExportComponent> transformed(job.components.size());
+    parallelFor(job.components.size(),[&](size_t i)
+    {
+        transformComponent(job.components[i],job.transforms[i],scaling,upVector,options,transformed[i]);
+    });
+
+    // Materials: components with identical colors and texture share one material, and are merged into one mesh
+    std::map<std::vector<double>,size_t> materialMap;
+    std::vector<SCompactMesh> meshes;
+    std::vector<int> meshTextures;
+    std::vector<size_t> componentMeshes(transformed.size());
+    double bbMin[3]={DBL_MAX,DBL_MAX,DBL_MAX};
+    double bbMax[3]={-DBL_MAX,-DBL_MAX,-DBL_MAX};
+    for (size_t i=0;i<transformed.size();i++)
+    {
+        const SExportComponent& comp=transformed[i];
+        int texture=-1;
+        if ( (comp.textureId!=-1)&&(comp.textureCoordinates.size()>0) )
+            texture=textureIndices[comp.textureId];
+        std::vector<double> key(1,double(texture));
         if ((options&2)==0)
         {
-            aiColor3D colorAD(allShapeComponents[shapeCompI].colorAD[0],allShapeComponents[shapeCompI].colorAD[1],allShapeComponents[shapeCompI].colorAD[2]);
+            key.insert(key.end(),comp.colorAD,comp.colorAD+3);
+            key.insert(key.end(),comp.colorS,comp.colorS+3);
+            key.insert(key.end(),comp.colorE,comp.colorE+3);
+        }
+        std::map<std::vector<double>,size_t>::iterator it=materialMap.find(key);
+        if (it==materialMap.end())
+        {
+            it=materialMap.insert(std::make_pair(key,meshes.size())).first;
+            meshes.push_back(SCompactMesh());
+            meshes.back().materialIndex=meshes.size()-1;
+            meshTextures.push_back(texture);
+        }
+        componentMeshes[i]=it->second;
+        for (size_t j=0;j<comp.vertices.size()/3;j++)
+        {
+            for (size_t k=0;k<3;k++)
+            {
+                bbMin[k]=std::min<double>(bbMin[k],comp.vertices[3*j+k]);
+                bbMax[k]=std::max<double>(bbMax[k],comp.vertices[3*j+k]);
+            }
+        }
+    }
+    double extent=std::max<double>(bbMax[0]-bbMin[0],std::max<double>(bbMax[1]-bbMin[1],bbMax[2]-bbMin[2]));
+    double positionStep=std::max<double>(extent,1e-9)/double((1LL<<positionBits)-1);
+    double normalSteps=double((1LL<<(normalBits-1))-1);
+    double uvSteps=double((1LL<<uvBits)-1);
+
+    // Welding, in parallel across meshes
+    std::vector<std::vector<size_t>> meshComponents(meshes.size());
+    for (size_t i=0;i<transformed.size();i++)
+        meshComponents[componentMeshes[i]].push_back(i);
+    size_t verticesBefore=0;
+    for (size_t i=0;i<transformed.size();i++)
+        verticesBefore+=transformed[i].indices.size();
+    parallelFor(meshes.size(),[&](size_t m)
+    {
+        for (size_t i=0;i<meshComponents[m].size();i++)
+        {
+            SExportComponent& comp=transformed[meshComponents[m][i]];
+            appendCompactComponent(comp,bbMin,positionStep,normalSteps,uvSteps,options,meshes[m]);
+            comp=SExportComponent(); // release early
+        }
+        std::unordered_map<SCompactVertexKey,int,SCompactVertexKeyHash>().swap(meshes[m].vertexMap);
+    });
+
+    aiScene scene;
+    scene.mNumMaterials=(unsigned int)meshes.size();
+    scene.mMaterials=new aiMaterial*[meshes.size()]();
+    scene.mNumMeshes=(unsigned int)meshes.size();
+    scene.mMeshes=new aiMesh*[meshes.size()]();
+    if (embeddedTextures.size()>0)
+    {
+        scene.mNumTextures=(unsigned int)embeddedTextures.size();
+        scene.mTextures=new aiTexture*[embeddedTextures.size()];
+        for (size_t i=0;i<embeddedTextures.size();i++)
+            scene.mTextures[i]=embeddedTextures[i];
+    }
+    size_t verticesAfter=0;
+    for (size_t m=0;m<meshes.size();m++)
+    {
+        const SCompactMesh& mesh=meshes[m];
+        const SExportComponent& firstComp=job.components[meshComponents[m][0]];
+        aiMaterial* pMaterial=new aiMaterial();
+        scene.mMaterials[m]=pMaterial;
+        if ((options&2)==0)
+        {
+            aiColor3D colorAD(firstComp.colorAD[0],firstComp.colorAD[1],firstComp.colorAD[2]);
             pMaterial->AddProperty(&colorAD,3,AI_MATKEY_COLOR_AMBIENT);
             pMaterial->AddProperty(&colorAD,3,AI_MATKEY_COLOR_DIFFUSE);
-            aiColor3D colorS(allShapeComponents[shapeCompI].colorS[0],allShapeComponents[shapeCompI].colorS[1],allShapeComponents[shapeCompI].colorS[2]);
+            aiColor3D colorS(firstComp.colorS[0],firstComp.colorS[1],firstComp.colorS[2]);
             pMaterial->AddProperty(&colorS,3,AI_MATKEY_COLOR_SPECULAR);
-            aiColor3D colorE(allShapeComponents[shapeCompI].colorE[0],allShapeComponents[shapeCompI].colorE[1],allShapeComponents[shapeCompI].colorE[2]);
+            aiColor3D colorE(firstComp.colorE[0],firstComp.colorE[1],firstComp.colorE[2]);
             pMaterial->AddProperty(&colorE,3,AI_MATKEY_COLOR_EMISSIVE);
         }
+        aiMesh* pMesh=new aiMesh();
+        scene.mMeshes[m]=pMesh;
+        pMesh->mMaterialIndex=(unsigned int)m;
+        size_t vCnt=mesh.vertices.size()/3;
+        verticesAfter+=vCnt;
+        pMesh->mNumVertices=(unsigned int)vCnt;
+        pMesh->mVertices=new aiVector3D[vCnt];
+        for (size_t i=0;i<vCnt;i++)
+            pMesh->mVertices[i]=aiVector3D(mesh.vertices[3*i+0],mesh.vertices[3*i+1],mesh.vertices[3*i+2]);
+        if (mesh.normals.size()==mesh.vertices.size())
+        {
+            pMesh->mNormals=new aiVector3D[vCnt];
+            for (size_t i=0;i<vCnt;i++)
+                pMesh->mNormals[i]=aiVector3D(mesh.normals[3*i+0],mesh.normals[3*i+1],mesh.normals[3*i+2]);
+        }
+        if ( (meshTextures[m]>=0)&&(mesh.textureCoords.size()==2*vCnt) )
+        {
+            pMesh->mTextureCoords[0]=new aiVector3D[vCnt];
+            pMesh->mNumUVComponents[0]=2;
+            for (size_t i=0;i<vCnt;i++)
+                pMesh->mTextureCoords[0][i]=aiVector3D(mesh.textureCoords[2*i+0],mesh.textureCoords[2*i+1],0.0);
+            aiString filePath("*"+std::to_string(meshTextures[m]));
+            pMaterial->AddProperty(&filePath,AI_MATKEY_TEXTURE_DIFFUSE(0));
+        }
+        pMesh->mNumFaces=(unsigned int)(mesh.indices.size()/3);
+        pMesh->mFaces=new aiFace[mesh.indices.size()/3];
+        for (size_t i=0;i<mesh.indices.size()/3;i++)
+        {
+            aiFace& face=pMesh->mFaces[i];
+            face.mNumIndices=3;
+            face.mIndices=new unsigned int[3];
+            face.mIndices[0]=mesh.indices[3*i+0];
+            face.mIndices[1]=mesh.indices[3*i+1];
+            face.mIndices[2]=mesh.indices[3*i+2];
+        }
+    }
+    setFlatRootNode(scene);
 
-        auto pMesh=scene.mMeshes[shapeCompI];
+    PooledExporter exporter=acquireExporter();
+    bool retVal=exportScene(*exporter,&scene,"glb2",filename,nullptr);
+    if ((options&256)==0)
+    {
+        std::string txt;
+        if (retVal)
+        {
+            txt="compact export: "+std::to_string(job.components.size())+" components in "+std::to_string(meshes.size())+" meshes, "+std::to_string(verticesBefore)+" vertices welded to "+std::to_string(verticesAfter)+", "+std::to_string(job.textures.size())+" textures stored as "+std::to_string(embeddedTextures.size());
+            std::error_code ec;
+            uintmax_t compactSize=std::filesystem::file_size(std::filesystem::u8path(filename),ec);
+            if (!ec)
+                txt+=", "+std::to_string(compactSize)+" bytes";
+        }
+        else
+            txt=std::string("failed exporting ")+filename+": "+exporter->GetErrorString();
+        simAddLog("Assimp",retVal?sim_verbosity_infos:sim_verbosity_errors,txt.c_str());
+    }
+    return(retVal);
+}
+
+SIM_DLLEXPORT void simAssimp_exportShapesCompact(exportShapesCompact_in *in, exportShapesCompact_out *out)
+{
+    if (in->shapeHandles.size()<1) throw std::runtime_error("invalid shapeHandles");
+    if(in->scaling < 0.001) throw std::runtime_error("invalid scaling");
+    if(in->upVector < 1) throw std::runtime_error("invalid upVector");
+    if(in->upVector > 2) throw std::runtime_error("invalid upVector");
+    if(in->options < 0) throw std::runtime_error("invalid options");
+    if(in->maxTextureSize < 8) throw std::runtime_error("invalid maxTextureSize");
+    if( (in->positionBits < 8)||(in->positionBits > 24) ) throw std::runtime_error("invalid positionBits");
+    if( (in->normalBits < 4)||(in->normalBits > 16) ) throw std::runtime_error("invalid normalBits");
+    if( (in->uvBits < 8)||(in->uvBits > 16) ) throw std::runtime_error("invalid uvBits");
+
+    assimpExportShapesCompact(in->shapeHandles,in->filename.c_str(),in->scaling,parseVectorUp(in->upVector,0),in->options,in->maxTextureSize,in->positionBits,in->normalBits,in->uvBits);
+}
+
+// Incremental export: the session keeps, per shape, the components in the shape frame (re-read only when the
+// shape is new, was replaced, or was invalidated), and the transformed components (recomputed only when the pose
+// changed). Textures are saved once per session, and again only if their file disappeared
+struct SExportSession
+{
+    struct SShape
+    {
+        int uniqueId;
+        bool dirty;
+        bool transformed;
+        C7Vector pose;
+        std::vector<SExportComponent> localComponents;
+        std::vector<SExportComponent> components;
+    };
+    std::string filename;
+    std::string format;
+    double scaling;
+    int upVector;
+    int options;
+    std::map<int,SShape> shapes;
+    std::map<int,SExportTexture> textures;
+    std::unordered_set<int> savedTextures;
+    std::unordered_set<int> staleTextures; // to be read again, by the next shape that uses them
+};
+std::map<int,std::unique_ptr<SExportSession>> exportSessions;
+int nextExportSessionHandle=1;
+
+SExportSession* getExportSession(int sessionHandle)
+{
+    std::map<int,std::unique_ptr<SExportSession>>::iterator it=exportSessions.find(sessionHandle);
+    if (it==exportSessions.end())
+        return(nullptr);
+    return(it->second.get());
+}
+
+bool samePose(const C7Vector& a,const C7Vector& b)
+{
+    for (size_t i=0;i<3;i++)
+    {
+        if (a.X(i)!=b.X(i))
+            return(false);
+    }
+    for (size_t i=0;i<4;i++)
+    {
+        if (a.Q(i)!=b.Q(i))
+            return(false);
+    }
+    return(true);
+}
 
-        pMesh->mVertices=new aiVector3D[allShapeComponents[shapeCompI].verticesSize/3];
-        pMesh->mNumVertices=allShapeComponents[shapeCompI].verticesSize/3;
-        for (int i=0;i<allShapeComponents[shapeCompI].verticesSize/3;i++)
+bool assimpExportSessionWrite(SExportSession& session,const std::vector<int>& shapeHandles)
+{
+    int options=session.options;
+    size_t reread=0;
+    size_t retransformed=0;
+    std::vector<const SExportComponent*> components;
+    std::unordered_set<int> exportedShapes;
+    std::map<int,SExportTexture> staleTextures;
+    for (std::unordered_set<int>::iterator it=session.staleTextures.begin();it!=session.staleTextures.end();++it)
+    {
+        std::map<int,SExportTexture>::iterator textIt=session.textures.find(*it);
+        if (textIt!=session.textures.end())
         {
-            double* v=allShapeComponents[shapeCompI].vertices;
-            pMesh->mVertices[i]=aiVector3D(v[3*i+0],v[3*i+1],v[3*i+2]);
+            staleTextures[*it]=textIt->second;
+            session.textures.erase(textIt);
         }
+    }
+    session.staleTextures.clear();
+    C7Vector firstTrInv;
+    for (size_t shapeI=0;shapeI<shapeHandles.size();shapeI++)
+    {
+        int h=shapeHandles[shapeI];
+        C7Vector tr;
+        getExportPose(h,tr);
+        if (shapeI==0)
+            firstTrInv=tr.getInverse();
+        if ((options&512)!=0)
+            tr=firstTrInv*tr;
+        int visible;
+        simGetObjectInt32Param(h,sim_objintparam_visible,&visible);
+        if ( ((options&8)!=0)&&(visible==0) )
+            continue;
+        int uniqueId=-1;
+        simGetObjectInt32Param(h,sim_objintparam_unique_id,&uniqueId);
+        std::map<int,SExportSession::SShape>::iterator it=session.shapes.find(h);
+        if ( (it==session.shapes.end())||(it->second.uniqueId!=uniqueId) )
+        { // new shape, or the handle now refers to another object
+            SExportSession::SShape s;
+            s.uniqueId=uniqueId;
+            s.dirty=true;
+            s.transformed=false;
+            it=session.shapes.insert_or_assign(h,s).first;
+        }
+        SExportSession::SShape& s=it->second;
+        if (s.dirty)
+        {
+            s.localComponents.clear();
+            extractShapeComponents(h,options,s.localComponents,session.textures);
+            s.dirty=false;
+            s.transformed=false;
+            reread++;
+        }
+        if ( (!s.transformed)||(!samePose(s.pose,tr)) )
+        {
+            s.components.resize(s.localComponents.size());
+            for (size_t i=0;i<s.localComponents.size();i++)
+                transformComponent(s.localComponents[i],tr,session.scaling,session.upVector,options,s.components[i]);
+            s.pose=tr;
+            s.transformed=true;
+            retransformed++;
+        }
+        exportedShapes.insert(h);
+        for (size_t i=0;i<s.components.size();i++)
+            components.push_back(&s.components[i]);
+    }
+    for (std::map<int,SExportTexture>::iterator textIt=staleTextures.begin();textIt!=staleTextures.end();textIt++)
+    { // stale textures that no re-read shape uses anymore are kept, cached shapes might still refer to them
+        if (session.textures.find(textIt->first)==session.textures.end())
+            session.textures[textIt->first]=textIt->second;
+    }
+    for (std::map<int,SExportSession::SShape>::iterator it=session.shapes.begin();it!=session.shapes.end();)
+    { // forget shapes that are not exported anymore
+        if (exportedShapes.find(it->first)==exportedShapes.end())
+            it=session.shapes.erase(it);
+        else
+            ++it;
+    }
+    if ((options&256)==0)
+    {
+        std::string txt("exporting "+session.filename+" ("+std::to_string(reread)+" shapes read, "+std::to_string(retransformed)+" transformed, "+std::to_string(exportedShapes.size()-retransformed)+" cached)");
+        simAddLog("Assimp",sim_verbosity_infos,txt.c_str());
+    }
+    if (components.size()==0)
+    {
+        if ((options&256)==0)
+            simAddLog("Assimp",sim_verbosity_errors,"nothing to export");
+        return(false);
+    }
 
-        if ((options&4)==0)
+    for (std::map<int,SExportTexture>::iterator textIt=session.textures.begin();textIt!=session.textures.end();textIt++)
+    {
+        std::string fn(getTextureFilename(session.filename.c_str(),textIt->first));
+        if ( (session.savedTextures.find(textIt->first)==session.savedTextures.end())||(!std::filesystem::exists(std::filesystem::u8path(fn))) )
         {
-            pMesh->mNormals=new aiVector3D[allShapeComponents[shapeCompI].indicesSize];
-    //        pMesh->mNumNormals=allShapeComponents[shapeCompI].indicesSize;
-            for (int i=0;i<allShapeComponents[shapeCompI].indicesSize;i++)
+            if (simSaveImage(textIt->second.image.data(),textIt->second.imgRes,1,fn.c_str(),-1,nullptr)>0)
             {
-                double* n=allShapeComponents[shapeCompI].normals;
-                pMesh->mNormals[i]=aiVector3D(n[3*i+0],n[3*i+1],n[3*i+2]);
+                session.savedTextures.insert(textIt->first);
+                textIt->second.filename=stripPath(fn);
+            }
+            else if ((options&256)==0)
+            { // retried on the next write
+                std::string txt("failed saving texture "+fn);
+                simAddLog("Assimp",sim_verbosity_warnings,txt.c_str());
             }
         }
+    }
+
+    std::vector<aiTexture*> embeddedTextures;
+    return(exportComponents(components,session.textures,embeddedTextures,session.filename.c_str(),session.format.c_str(),options,nullptr));
+}
+
+SIM_DLLEXPORT void simAssimp_exportSessionCreate(exportSessionCreate_in *in, exportSessionCreate_out *out)
+{
+    if(exportFormatsById.find(in->formatId)==exportFormatsById.end()) throw std::runtime_error("invalid format");
+    if(in->scaling < 0.001) throw std::runtime_error("invalid scaling");
+    if(in->upVector < 1) throw std::runtime_error("invalid upVector");
+    if(in->upVector > 2) throw std::runtime_error("invalid upVector");
+    if(in->options < 0) throw std::runtime_error("invalid options");
 
-        pMesh->mFaces=new aiFace[allShapeComponents[shapeCompI].indicesSize/3];
-        pMesh->mNumFaces=allShapeComponents[shapeCompI].indicesSize/3;
-        for (int i=0;i<allShapeComponents[shapeCompI].indicesSize/3;i++)
+    std::unique_ptr<SExportSession> s(new SExportSession());
+    s->filename=in->filename;
+    s->format=in->formatId;
+    s->scaling=in->scaling;
+    s->upVector=parseVectorUp(in->upVector,0);
+    s->options=in->options;
+    out->sessionHandle=nextExportSessionHandle++;
+    exportSessions[out->sessionHandle]=std::move(s);
+}
+
+SIM_DLLEXPORT void simAssimp_exportSessionWrite(exportSessionWrite_in *in, exportSessionWrite_out *out)
+{
+    SExportSession* s=getExportSession(in->sessionHandle);
+    if (s==nullptr) throw std::runtime_error("invalid sessionHandle");
+    if (in->shapeHandles.size()<1) throw std::runtime_error("invalid shapeHandles");
+
+    if (!assimpExportSessionWrite(s[0],in->shapeHandles)) throw std::runtime_error("export failed");
+}
+
+SIM_DLLEXPORT void simAssimp_exportSessionInvalidate(exportSessionInvalidate_in *in, exportSessionInvalidate_out *out)
+{
+    SExportSession* s=getExportSession(in->sessionHandle);
+    if (s==nullptr) throw std::runtime_error("invalid sessionHandle");
+
+    if (in->shapeHandles.size()==0)
+    { // all shapes, and all textures
+        s->shapes.clear();
+        s->textures.clear();
+        s->savedTextures.clear();
+    }
+    for (size_t i=0;i<in->shapeHandles.size();i++)
+    {
+        std::map<int,SExportSession::SShape>::iterator it=s->shapes.find(in->shapeHandles[i]);
+        if (it!=s->shapes.end())
         {
-            int* tri=allShapeComponents[shapeCompI].indices;
-            aiFace& face=pMesh->mFaces[i];
-            face.mIndices=new unsigned int[3];
-            face.mNumIndices=3;
-            face.mIndices[0]=tri[3*i+0];
-            face.mIndices[1]=tri[3*i+1];
-            face.mIndices[2]=tri[3*i+2];
+            it->second.dirty=true;
+            for (size_t j=0;j<it->second.localComponents.size();j++)
+            { // the texture might have changed too
+                int textureId=it->second.localComponents[j].textureId;
+                if (textureId!=-1)
+                {
+                    s->staleTextures.insert(textureId);
+                    s->savedTextures.erase(textureId);
+                }
+            }
         }
+    }
+}
+
+SIM_DLLEXPORT void simAssimp_exportSessionDestroy(exportSessionDestroy_in *in, exportSessionDestroy_out *out)
+{
+    if (exportSessions.erase(in->sessionHandle)==0) throw std::runtime_error("invalid sessionHandle");
+}
+
+// Pose-track recording: the geometry is read once, in the shape frames, then each step only appends the shape
+// poses. On stop, a single file is written, with one node per shape, animated by the recorded poses
+struct SRecording
+{
+    struct SShape
+    {
+        int handle;
+        std::string name;
+        std::vector<SExportComponent> components; // in the shape frame, scaled and with the up-vector applied
+    };
+    std::string filename;
+    std::string format;
+    double scaling;
+    int upVector;
+    int options;
+    C7Vector firstTrInv;
+    std::vector<SShape> shapes;
+    std::map<int,SExportTexture> textures;
+    std::vector<double> times;
+    std::vector<double> poses; // 7 values (x,y,z,qw,qx,qy,qz) per shape and step, already in the exported frame
+};
+std::map<int,std::unique_ptr<SRecording>> recordings;
+int nextRecordingHandle=1;
+
+SRecording* getRecording(int recordingHandle)
+{
+    std::map<int,std::unique_ptr<SRecording>>::iterator it=recordings.find(recordingHandle);
+    if (it==recordings.end())
+        return(nullptr);
+    return(it->second.get());
+}
 
-        if ( (allShapeComponents[shapeCompI].textureCoordinates!=nullptr)&&((options&1)==0) )
-        {
-            pMesh->mTextureCoords[0]=new aiVector3D[allShapeComponents[shapeCompI].verticesSize/3];
-            pMesh->mNumUVComponents[0]=allShapeComponents[shapeCompI].verticesSize/3;
-            for (int i=0;i<allShapeComponents[shapeCompI].indicesSize/3;i++)
-            {
-                int* tri=allShapeComponents[shapeCompI].indices;
-                int index[3]={tri[3*i+0],tri[3*i+1],tri[3*i+2]};
-                float* tCoords=allShapeComponents[shapeCompI].textureCoordinates;
-                pMesh->mTextureCoords[0][index[0]]=aiVector3D((double)tCoords[6*i+0],(double)tCoords[6*i+1],0.0);
-                pMesh->mTextureCoords[0][index[1]]=aiVector3D((double)tCoords[6*i+2],(double)tCoords[6*i+3],0.0);
-                pMesh->mTextureCoords[0][index[2]]=aiVector3D((double)tCoords[6*i+4],(double)tCoords[6*i+5],0.0);
-            }
-            std::map<int,STexture>::iterator textIt=allTextures.find(allShapeComponents[shapeCompI].textureId);
-            if (textIt!=allTextures.end())
+void recordPoses(SRecording& rec)
+{ // O(shapes): no geometry is touched
+    double t=simGetSimulationTime();
+    if ( (rec.times.size()>0)&&(t==rec.times.back()) )
+        return; // simulation stopped or paused: keys must have distinct times
+    bool hasPrevStep=(rec.times.size()>0);
+    size_t prevStep=hasPrevStep?rec.poses.size()-7*rec.shapes.size():0;
+    rec.times.push_back(t);
+    // the exported frame is C*S*(world frame), C being identity for z-up, or a -90 deg. rotation around x for y-up.
+    // A vertex v of a shape at pose (R,p) becomes S*C*(R*v+p)=(C*R*C^-1)*(S*C*v)+S*C*p, and S*C*v is what is stored
+    C4Vector c;
+    c.setIdentity();
+    if (rec.upVector!=1)
+        c=C4Vector(sqrt(0.5),-sqrt(0.5),0.0,0.0);
+    C4Vector cInv(c.getInverse());
+    for (size_t i=0;i<rec.shapes.size();i++)
+    {
+        C7Vector tr;
+        if (!getExportPose(rec.shapes[i].handle,tr))
+        { // the shape was removed: it holds its last key
+            if (!hasPrevStep)
             {
-                aiString filePath(textIt->second.filename);
-                pMaterial->AddProperty(&filePath,AI_MATKEY_TEXTURE_DIFFUSE(0));
+                rec.times.pop_back();
+                rec.poses.resize(rec.poses.size()-7*i);
+                throw std::runtime_error("invalid shapeHandles");
             }
+            for (size_t j=0;j<7;j++)
+                rec.poses.push_back(rec.poses[prevStep+7*i+j]);
+            continue;
         }
-        else
-        {
-            pMesh->mTextureCoords[0]=nullptr;
-            pMesh->mNumUVComponents[0]=0;
-        }
+        if ((rec.options&512)!=0)
+            tr=rec.firstTrInv*tr;
+        C3Vector p=c*tr.X;
+        C4Vector q=c*tr.Q*cInv;
+        rec.poses.push_back(p(0)*rec.scaling);
+        rec.poses.push_back(p(1)*rec.scaling);
+        rec.poses.push_back(p(2)*rec.scaling);
+        for (size_t j=0;j<4;j++)
+            rec.poses.push_back(q(j));
     }
+}
 
-    Assimp::Exporter exporter;
-    exporter.Export(&scene,format,filename);
+bool writeRecording(SRecording& rec)
+{
+    if ((rec.options&256)==0)
+    {
+        std::string txt("exporting "+rec.filename+" ("+std::to_string(rec.times.size())+" recorded steps)");
+        simAddLog("Assimp",sim_verbosity_infos,txt.c_str());
+    }
+    for (std::map<int,SExportTexture>::iterator textIt=rec.textures.begin();textIt!=rec.textures.end();textIt++)
+    {
+        std::string fn(getTextureFilename(rec.filename.c_str(),textIt->first));
+        simSaveImage(textIt->second.image.data(),textIt->second.imgRes,1,fn.c_str(),-1,nullptr);
+        textIt->second.filename=stripPath(fn);
+    }
 
-    // Release memory:
-    for (size_t i=0;i<allShapeComponents.size();i++)
+    std::vector<const SExportComponent*> components;
+    for (size_t i=0;i<rec.shapes.size();i++)
     {
-        simReleaseBuffer((char*)allShapeComponents[i].vertices);
-        simReleaseBuffer((char*)allShapeComponents[i].indices);
-        simReleaseBuffer((char*)allShapeComponents[i].normals);
-        simReleaseBuffer((char*)allShapeComponents[i].textureCoordinates);
+        for (size_t j=0;j<rec.shapes[i].components.size();j++)
+            components.push_back(&rec.shapes[i].components[j]);
     }
-    std::map<int,STexture>::iterator textIt;
-    for (textIt=allTextures.begin();textIt!=allTextures.end();textIt++)
-        simReleaseBuffer((char*)textIt->second.image);
-}
+    if (components.size()==0)
+    {
+        if ((rec.options&256)==0)
+            simAddLog("Assimp",sim_verbosity_errors,"nothing to export");
+        return(false);
+    }
+    aiScene scene;
+    std::vector<aiTexture*> embeddedTextures;
+    fillExportScene(scene,components,rec.textures,embeddedTextures,rec.options);
 
+    size_t stepCnt=rec.times.size();
+    size_t shapeCnt=rec.shapes.size();
+    scene.mRootNode=new aiNode();
+    scene.mRootNode->mName.Set("root");
+    std::vector<aiNode*> nodes;
+    unsigned int meshIndex=0;
+    for (size_t i=0;i<shapeCnt;i++)
+    {
+        aiNode* node=new aiNode(rec.shapes[i].name);
+        node->mNumMeshes=(unsigned int)rec.shapes[i].components.size();
+        if (node->mNumMeshes>0)
+        {
+            node->mMeshes=new unsigned int[node->mNumMeshes];
+            for (size_t j=0;j<node->mNumMeshes;j++)
+                node->mMeshes[j]=meshIndex++;
+        }
+        const double* pose=&rec.poses[7*i]; // first step
+        node->mTransformation=aiMatrix4x4(aiVector3D(1.0,1.0,1.0),aiQuaternion(pose[3],pose[4],pose[5],pose[6]),aiVector3D(pose[0],pose[1],pose[2]));
+        nodes.push_back(node);
+    }
+    scene.mRootNode->addChildren((unsigned int)nodes.size(),nodes.data());
 
-SIM_DLLEXPORT void simAssimp_exportShapes(exportShapes_in *in, exportShapes_out *out)
-{
-    Assimp::Exporter exp;
-    int fi=0;
-    bool formatOk=false;
-    while (fi<exp.GetExportFormatCount())
+    aiAnimation* anim=new aiAnimation();
+    anim->mName.Set("recording");
+    anim->mTicksPerSecond=1000.0; // times are in ms
+    anim->mDuration=(rec.times.back()-rec.times.front())*1000.0;
+    anim->mNumChannels=(unsigned int)shapeCnt;
+    anim->mChannels=new aiNodeAnim*[shapeCnt];
+    for (size_t i=0;i<shapeCnt;i++)
     {
-        if (in->formatId.compare(exp.GetExportFormatDescription(fi++)->id)==0)
+        aiNodeAnim* channel=new aiNodeAnim();
+        channel->mNodeName.Set(rec.shapes[i].name);
+        channel->mNumPositionKeys=(unsigned int)stepCnt;
+        channel->mPositionKeys=new aiVectorKey[stepCnt];
+        channel->mNumRotationKeys=(unsigned int)stepCnt;
+        channel->mRotationKeys=new aiQuatKey[stepCnt];
+        for (size_t j=0;j<stepCnt;j++)
         {
-            formatOk=true;
-            break;
+            double t=(rec.times[j]-rec.times.front())*1000.0;
+            const double* pose=&rec.poses[7*(j*shapeCnt+i)];
+            channel->mPositionKeys[j].mTime=t;
+            channel->mPositionKeys[j].mValue=aiVector3D(pose[0],pose[1],pose[2]);
+            channel->mRotationKeys[j].mTime=t;
+            channel->mRotationKeys[j].mValue=aiQuaternion(pose[3],pose[4],pose[5],pose[6]);
         }
+        channel->mNumScalingKeys=1;
+        channel->mScalingKeys=new aiVectorKey[1];
+        channel->mScalingKeys[0].mTime=0.0;
+        channel->mScalingKeys[0].mValue=aiVector3D(1.0,1.0,1.0);
+        anim->mChannels[i]=channel;
+    }
+    scene.mNumAnimations=1;
+    scene.mAnimations=new aiAnimation*[1];
+    scene.mAnimations[0]=anim;
+
+    PooledExporter exporter=acquireExporter();
+    bool retVal=exportScene(*exporter,&scene,rec.format.c_str(),rec.filename.c_str(),nullptr);
+    if ( (!retVal)&&((rec.options&256)==0) )
+    {
+        std::string txt("failed exporting "+rec.filename+": "+exporter->GetErrorString());
+        simAddLog("Assimp",sim_verbosity_errors,txt.c_str());
     }
+    return(retVal);
+}
 
+SIM_DLLEXPORT void simAssimp_recordingStart(recordingStart_in *in, recordingStart_out *out)
+{
     if (in->shapeHandles.size()<1) throw std::runtime_error("invalid shapeHandles");
-    if(!formatOk) throw std::runtime_error("invalid format");
+    if(exportFormatsById.find(in->formatId)==exportFormatsById.end()) throw std::runtime_error("invalid format");
     if(in->scaling < 0.001) throw std::runtime_error("invalid scaling");
     if(in->upVector < 1) throw std::runtime_error("invalid upVector");
     if(in->upVector > 2) throw std::runtime_error("invalid upVector");
     if(in->options < 0) throw std::runtime_error("invalid options");
 
-    assimpExportShapes(in->shapeHandles,in->filename.c_str(),in->formatId.c_str(),in->scaling,parseVectorUp(in->upVector,0),in->options);
+    std::unique_ptr<SRecording> rec(new SRecording());
+    rec->filename=in->filename;
+    rec->format=in->formatId;
+    rec->scaling=in->scaling;
+    rec->upVector=parseVectorUp(in->upVector,0);
+    rec->options=in->options;
+    C7Vector firstTr;
+    if (!getExportPose(in->shapeHandles[0],firstTr)) throw std::runtime_error("invalid shapeHandles");
+    rec->firstTrInv=firstTr.getInverse();
+    C7Vector identity;
+    identity.setIdentity();
+    for (size_t i=0;i<in->shapeHandles.size();i++)
+    {
+        SRecording::SShape s;
+        s.handle=in->shapeHandles[i];
+        char* alias=simGetObjectAlias(s.handle,-1);
+        if (alias!=nullptr)
+        {
+            s.name=alias;
+            simReleaseBuffer(alias);
+        }
+        s.name+="_"+std::to_string(s.handle); // node names must be unique
+        std::vector<SExportComponent> components;
+        extractShapeComponents(s.handle,rec->options,components,rec->textures);
+        s.components.resize(components.size());
+        for (size_t j=0;j<components.size();j++)
+            transformComponent(components[j],identity,rec->scaling,rec->upVector,rec->options,s.components[j]);
+        rec->shapes.push_back(s);
+    }
+    recordPoses(*rec);
+    out->recordingHandle=nextRecordingHandle++;
+    recordings[out->recordingHandle]=std::move(rec);
 }
 
-void assimpImportMeshes(const char* fileNames,double scaling,int upVector,int options,std::vector<std::vector<double>>& allVertices,std::vector<std::vector<int>>& allIndices)
+SIM_DLLEXPORT void simAssimp_recordingStep(recordingStep_in *in, recordingStep_out *out)
 {
-    std::vector<std::string> filenames;
-    splitString(fileNames,';',filenames);
-    for (size_t wi=0;wi<filenames.size();wi++)
+    SRecording* rec=getRecording(in->recordingHandle);
+    if (rec==nullptr) throw std::runtime_error("invalid recordingHandle");
+
+    recordPoses(rec[0]);
+}
+
+SIM_DLLEXPORT void simAssimp_recordingStop(recordingStop_in *in, recordingStop_out *out)
+{
+    std::map<int,std::unique_ptr<SRecording>>::iterator it=recordings.find(in->recordingHandle);
+    if (it==recordings.end()) throw std::runtime_error("invalid recordingHandle");
+    std::unique_ptr<SRecording> rec=std::move(it->second);
+    recordings.erase(it);
+
+    if (!in->discard)
+        writeRecording(*rec);
+}
+
+struct SMeshImportSession
+{ // keeps the Assimp scenes alive, so that meshes can be converted straight into their final buffers
+    struct SMesh
+    {
+        std::vector<const aiMesh*> parts; // more than one part with option 32 (one mesh per file)
+        double scaling;
+        int upVector;
+        int verticesSize;
+        int indicesSize;
+    };
+    std::vector<PooledImporter> importers;
+    std::vector<SMesh> meshes;
+};
+
+void assimpLoadMeshes(const std::vector<SImportSource>& sources,double scaling,int upVector,int options,double weldTolerance,SMeshImportSession& session)
+{
+    for (size_t wi=0;wi<sources.size();wi++)
     {
-        bool newFile=true;
         if ((options&256)==0)
         {
             std::string txt("importing ");
-            txt+=filenames[wi];
+            txt+=sources[wi].name;
             simAddLog("Assimp",sim_verbosity_infos,txt.c_str());
         }
-        Assimp::Importer importer;
-        importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS,aiComponent_ANIMATIONS|aiComponent_LIGHTS|aiComponent_CAMERAS);
-        importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE,aiPrimitiveType_POINT|aiPrimitiveType_LINE);
-        int flags=aiProcess_Triangulate|aiProcess_OptimizeGraph|
-                aiProcess_SortByPType|aiProcess_RemoveComponent|aiProcess_DropNormals|
-                aiProcess_RemoveRedundantMaterials|aiProcess_FindDegenerates|aiProcess_FindInvalidData|
-                aiProcess_GenUVCoords|aiProcess_TransformUVCoords|aiProcess_EmbedTextures;
-        if ((options&32)!=0)
-            options=(options|24)-24;
-        if ((options&8)==0)
-            flags|=aiProcess_OptimizeMeshes;
-        if ((options&16)==0)
-            flags|=aiProcess_JoinIdenticalVertices;
-        if ((options&128)!=0)
-            importer.SetPropertyInteger(AI_CONFIG_IMPORT_COLLADA_IGNORE_UP_DIRECTION,1);
-        const aiScene* scene = importer.ReadFile(filenames[wi].c_str(),flags);
+        PooledImporter importer=acquireImporter();
+        int flags=prepareImporter(*importer,options);
+        const aiScene* scene = readScene(*importer,sources[wi],flags);
         if(scene)
         {
-            double minMaxX[2]={9999999.0,-9999999.0};
-            double minMaxY[2]={9999999.0,-9999999.0};
-            double minMaxZ[2]={9999999.0,-9999999.0};
-            for (size_t i=0;i<scene->mNumMeshes;i++)
-            {
-                const aiMatrix4x4* tr=getTransform(scene->mRootNode,&scene->mRootNode->mTransformation,i);
-                const aiMesh* mesh = scene->mMeshes[i];
-                for (size_t j=0;j<mesh->mNumVertices;j++)
+            transformVertices(scene,scaling,upVector);
+            if (weldTolerance>0.0)
+            { // the tolerance is in scene units, i.e. after scaling
+                std::vector<SWeldStats> stats(scene->mNumMeshes);
+                parallelFor(scene->mNumMeshes,[&](size_t i)
                 {
-                    if (tr!=nullptr)
-                        mesh->mVertices[j]*=tr[0];
-                    if (mesh->mVertices[j].x<minMaxX[0])
-                        minMaxX[0]=mesh->mVertices[j].x;
-                    if (mesh->mVertices[j].x>minMaxX[1])
-                        minMaxX[1]=mesh->mVertices[j].x;
-                    if (mesh->mVertices[j].y<minMaxY[0])
-                        minMaxY[0]=mesh->mVertices[j].y;
-                    if (mesh->mVertices[j].y>minMaxY[1])
-                        minMaxY[1]=mesh->mVertices[j].y;
-                    if (mesh->mVertices[j].z<minMaxZ[0])
-                        minMaxZ[0]=mesh->mVertices[j].z;
-                    if (mesh->mVertices[j].z>minMaxZ[1])
-                        minMaxZ[1]=mesh->mVertices[j].z;
-                }
+                    stats[i]=weldMesh(scene->mMeshes[i],weldTolerance/scaling);
+                });
+                if ((options&256)==0)
+                    logWeldStats(stats);
             }
-            double l=std::max<double>(minMaxX[1]-minMaxX[0],std::max<double>(minMaxY[1]-minMaxY[0],minMaxZ[1]-minMaxZ[0]));
-            if (scaling==0.0)
+            for (size_t i=0;i<scene->mNumMeshes;i++)
             {
-                scaling=1.0;
-                while (l>5.0)
-                {
-                    l*=0.1;
-                    scaling*=0.1;
-                }
-                while (l<0.05)
+                const aiMesh* mesh = scene->mMeshes[i];
+                if ( (i==0)||((options&32)==0) )
                 {
-                    l*=10.0;
-                    scaling*=10.0;
+                    SMeshImportSession::SMesh m;
+                    m.scaling=scaling;
+                    m.upVector=upVector;
+                    m.verticesSize=0;
+                    m.indicesSize=0;
+                    session.meshes.push_back(m);
                 }
+                SMeshImportSession::SMesh& m=session.meshes[session.meshes.size()-1];
+                m.parts.push_back(mesh);
+                m.verticesSize+=3*mesh->mNumVertices;
+                m.indicesSize+=3*mesh->mNumFaces;
             }
-            if (upVector==0)
+            session.importers.push_back(std::move(importer));
+        }
+    }
+}
+
+template<typename T>
+void writeMeshVertices(const SMeshImportSession::SMesh& m,T* vertices)
+{
+    for (size_t pi=0;pi<m.parts.size();pi++)
+    {
+        const aiMesh* mesh=m.parts[pi];
+        for (size_t j=0;j<mesh->mNumVertices;j++)
+        {
+            if (m.upVector==1)
             {
-                if (minMaxZ[0]>=minMaxY[0])
-                    upVector=1;
-                else
-                    upVector=2;
+                vertices[0]=T(mesh->mVertices[j].x*m.scaling);
+                vertices[1]=T(mesh->mVertices[j].y*m.scaling);
+                vertices[2]=T(mesh->mVertices[j].z*m.scaling);
             }
-            for (size_t i=0;i<scene->mNumMeshes;i++)
+            else
             {
-                const aiMesh* mesh = scene->mMeshes[i];
-                std::vector<double> vertices;
-                std::vector<int> indices;
-                for (size_t j=0;j<mesh->mNumVertices;j++)
-                {
-                    if (upVector==1)
-                    {
-                        vertices.push_back(mesh->mVertices[j].x*scaling);
-                        vertices.push_back(mesh->mVertices[j].y*scaling);
-                        vertices.push_back(mesh->mVertices[j].z*scaling);
-                    }
-                    else
-                    {
-                        vertices.push_back(mesh->mVertices[j].x*scaling);
-                        vertices.push_back(-mesh->mVertices[j].z*scaling);
-                        vertices.push_back(mesh->mVertices[j].y*scaling);
-                    }
-                }
-                for (size_t j=0;j<mesh->mNumFaces;j++)
-                {
-                    const aiFace& face=mesh->mFaces[j];
-                    indices.push_back(face.mIndices[0]);
-                    indices.push_back(face.mIndices[1]);
-                    indices.push_back(face.mIndices[2]);
-                }
-                if ( newFile||((options&32)==0) )
-                {
-                    allVertices.push_back(std::vector<double>());
-                    allIndices.push_back(std::vector<int>());
-                    allVertices[allVertices.size()-1].assign(vertices.begin(),vertices.end());
-                    allIndices[allIndices.size()-1].assign(indices.begin(),indices.end());
-                }
-                else
-                {
-                    int off=allVertices[allVertices.size()-1].size()/3;
-                    allVertices[allVertices.size()-1].insert(allVertices[allVertices.size()-1].end(),vertices.begin(),vertices.end());
-                    for (size_t i=0;i<indices.size();i++)
-                        allIndices[allIndices.size()-1].push_back(indices[i]+off);
-                }
-                newFile=false;
+                vertices[0]=T(mesh->mVertices[j].x*m.scaling);
+                vertices[1]=T(-mesh->mVertices[j].z*m.scaling);
+                vertices[2]=T(mesh->mVertices[j].y*m.scaling);
             }
+            vertices+=3;
         }
     }
 }
 
-SIM_DLLEXPORT void simAssimp_importMeshes(importMeshes_in *in, importMeshes_out *out)
+void writeMeshIndices(const SMeshImportSession::SMesh& m,int* indices)
 {
-    if(in->scaling < 0.0) throw std::runtime_error("invalid scaling");
-    if(in->upVector < 0) throw std::runtime_error("invalid upVector");
-    if(in->upVector > 2) throw std::runtime_error("invalid upVector");
-    if(in->options < 0) throw std::runtime_error("invalid options");
+    int off=0;
+    for (size_t pi=0;pi<m.parts.size();pi++)
+    {
+        const aiMesh* mesh=m.parts[pi];
+        for (size_t j=0;j<mesh->mNumFaces;j++)
+        {
+            const aiFace& face=mesh->mFaces[j];
+            indices[0]=face.mIndices[0]+off;
+            indices[1]=face.mIndices[1]+off;
+            indices[2]=face.mIndices[2]+off;
+            indices+=3;
+        }
+        off+=mesh->mNumVertices;
+    }
+}
 
-    std::vector<std::vector<double>> allVertices;
-    std::vector<std::vector<int>> allIndices;
-    assimpImportMeshes(in->filenames.c_str(),in->scaling,parseVectorUp(in->upVector,0),in->options,allVertices,allIndices);
+template<typename T>
+void assimpImportMeshes(const std::vector<SImportSource>& sources,double scaling,int upVector,int options,double weldTolerance,std::vector<std::vector<T>>& allVertices,std::vector<std::vector<int>>& allIndices)
+{ // T is double or float. Vertices are written straight into the output vectors, in the requested precision
+    SMeshImportSession session;
+    assimpLoadMeshes(sources,scaling,upVector,options,weldTolerance,session);
+    allVertices.resize(session.meshes.size());
+    allIndices.resize(session.meshes.size());
+    for (size_t i=0;i<session.meshes.size();i++)
+    {
+        allVertices[i].resize(session.meshes[i].verticesSize);
+        allIndices[i].resize(session.meshes[i].indicesSize);
+        writeMeshVertices(session.meshes[i],allVertices[i].data());
+        writeMeshIndices(session.meshes[i],allIndices[i].data());
+    }
+}
 
-    simPopStackItem(in->_.stackID,simGetStackSize(in->_.stackID));
+template<typename T>
+void pushMeshesOntoStack(int stackID,const std::vector<std::vector<T>>& allVertices,const std::vector<std::vector<int>>& allIndices)
+{
+    simPopStackItem(stackID,simGetStackSize(stackID));
 
-    simPushTableOntoStack(in->_.stackID);
+    simPushTableOntoStack(stackID);
     for (size_t i=0;i<allVertices.size();i++)
     {
-        simPushInt32OntoStack(in->_.stackID,int(i+1));
-        if (allVertices[i].size()>0)
-            simPushDoubleTableOntoStack(in->_.stackID,&allVertices[i][0],int(allVertices[i].size()));
+        simPushInt32OntoStack(stackID,int(i+1));
+        if constexpr (std::is_same<T,float>::value)
+            simPushFloatTableOntoStack(stackID,allVertices[i].data(),int(allVertices[i].size()));
         else
-            simPushDoubleTableOntoStack(in->_.stackID,nullptr,0);
-        simInsertDataIntoStackTable(in->_.stackID);
+            simPushDoubleTableOntoStack(stackID,allVertices[i].data(),int(allVertices[i].size()));
+        simInsertDataIntoStackTable(stackID);
     }
 
-    simPushTableOntoStack(in->_.stackID);
+    simPushTableOntoStack(stackID);
     for (size_t i=0;i<allIndices.size();i++)
     {
-        simPushInt32OntoStack(in->_.stackID,int(i+1));
-        if (allIndices[i].size()>0)
-            simPushInt32TableOntoStack(in->_.stackID,&allIndices[i][0],int(allIndices[i].size()));
-        else
-            simPushInt32TableOntoStack(in->_.stackID,nullptr,0);
-        simInsertDataIntoStackTable(in->_.stackID);
+        simPushInt32OntoStack(stackID,int(i+1));
+        simPushInt32TableOntoStack(stackID,allIndices[i].data(),int(allIndices[i].size()));
+        simInsertDataIntoStackTable(stackID);
+    }
+}
+
+void importMeshesOntoStack(int stackID,const std::vector<SImportSource>& sources,double scaling,int upVector,int options,double weldTolerance)
+{
+    std::vector<std::vector<int>> allIndices;
+    if ((options&512)!=0)
+    { // single precision, as stored by Assimp
+        std::vector<std::vector<float>> allVertices;
+        assimpImportMeshes(sources,scaling,upVector,options,weldTolerance,allVertices,allIndices);
+        pushMeshesOntoStack(stackID,allVertices,allIndices);
+    }
+    else
+    {
+        std::vector<std::vector<double>> allVertices;
+        assimpImportMeshes(sources,scaling,upVector,options,weldTolerance,allVertices,allIndices);
+        pushMeshesOntoStack(stackID,allVertices,allIndices);
     }
 }
 
-void assimpExportMeshes(const std::vector<std::vector<double>>& vertices,const std::vector<std::vector<int>>& indices,const char* filename,const char* format,double scaling,int upVector,int options)
+SIM_DLLEXPORT void simAssimp_importMeshes(importMeshes_in *in, importMeshes_out *out)
+{
+    if(in->scaling < 0.0) throw std::runtime_error("invalid scaling");
+    if(in->upVector < 0) throw std::runtime_error("invalid upVector");
+    if(in->upVector > 2) throw std::runtime_error("invalid upVector");
+    if(in->options < 0) throw std::runtime_error("invalid options");
+    if(in->weldTolerance < 0.0) throw std::runtime_error("invalid weldTolerance");
+
+    importMeshesOntoStack(in->_.stackID,getFileSources(in->filenames.c_str()),in->scaling,parseVectorUp(in->upVector,0),in->options,in->weldTolerance);
+}
+
+SIM_DLLEXPORT void simAssimp_importMeshesFromBuffer(importMeshesFromBuffer_in *in, importMeshesFromBuffer_out *out)
 {
+    if(in->data.size() == 0) throw std::runtime_error("invalid data");
+    if(in->scaling < 0.0) throw std::runtime_error("invalid scaling");
+    if(in->upVector < 0) throw std::runtime_error("invalid upVector");
+    if(in->upVector > 2) throw std::runtime_error("invalid upVector");
+    if(in->options < 0) throw std::runtime_error("invalid options");
+    if(in->weldTolerance < 0.0) throw std::runtime_error("invalid weldTolerance");
+
+    importMeshesOntoStack(in->_.stackID,getBufferSource(in->data.data(),in->data.size(),in->formatHint.c_str()),in->scaling,parseVectorUp(in->upVector,0),in->options,in->weldTolerance);
+}
+
+template<typename T>
+bool assimpExportMeshes(int meshCnt,const T* const* vertices,const int* verticesSizes,const int* const* indices,const int* indicesSizes,const char* filename,const char* format,double scaling,int upVector,int options,std::vector<SExportedFile>* files=nullptr)
+{ // the caller's arrays are read in place. With files not null, exports to memory
     if ((options&256)==0)
     {
         std::string txt("exporting ");
-        txt+=filename;
+        if (files==nullptr)
+            txt+=filename;
+        else
+            txt+="to memory";
         simAddLog("Assimp",sim_verbosity_infos,txt.c_str());
     }
 
     aiScene scene;
     scene.mRootNode=new aiNode();
-    scene.mNumMaterials=vertices.size();
-    scene.mMaterials=new aiMaterial*[vertices.size()];
-    scene.mNumMeshes=vertices.size();
-    scene.mMeshes=new aiMesh*[vertices.size()];
-    scene.mRootNode->mNumMeshes=vertices.size();
-    scene.mRootNode->mMeshes=new unsigned int[vertices.size()];
-    for (size_t shapeCompI=0;shapeCompI<vertices.size();shapeCompI++)
+    scene.mNumMaterials=meshCnt;
+    scene.mMaterials=new aiMaterial*[meshCnt];
+    scene.mNumMeshes=meshCnt;
+    scene.mMeshes=new aiMesh*[meshCnt];
+    scene.mRootNode->mNumMeshes=meshCnt;
+    scene.mRootNode->mMeshes=new unsigned int[meshCnt];
+    for (int shapeCompI=0;shapeCompI<meshCnt;shapeCompI++)
     {
         scene.mMaterials[shapeCompI]=new aiMaterial();
         scene.mMeshes[shapeCompI]=new aiMesh();
@@ -918,11 +2446,11 @@ void assimpExportMeshes(const std::vector<std::vector<double>>& vertices,const s
 
         auto pMesh=scene.mMeshes[shapeCompI];
 
-        pMesh->mVertices=new aiVector3D[vertices[shapeCompI].size()/3];
-        pMesh->mNumVertices=vertices[shapeCompI].size()/3;
-        for (int i=0;i<vertices[shapeCompI].size()/3;i++)
+        pMesh->mVertices=new aiVector3D[verticesSizes[shapeCompI]/3];
+        pMesh->mNumVertices=verticesSizes[shapeCompI]/3;
+        const T* v=vertices[shapeCompI];
+        for (int i=0;i<verticesSizes[shapeCompI]/3;i++)
         {
-            const double* v=&(vertices[shapeCompI])[0];
             if (upVector!=2)
                 pMesh->mVertices[i]=aiVector3D(v[3*i+0]*scaling,v[3*i+1]*scaling,v[3*i+2]*scaling);
             else
@@ -931,11 +2459,11 @@ void assimpExportMeshes(const std::vector<std::vector<double>>& vertices,const s
 
         pMesh->mNormals=nullptr;
 
-        pMesh->mFaces=new aiFace[indices[shapeCompI].size()/3];
-        pMesh->mNumFaces=indices[shapeCompI].size()/3;
-        for (int i=0;i<indices[shapeCompI].size()/3;i++)
+        pMesh->mFaces=new aiFace[indicesSizes[shapeCompI]/3];
+        pMesh->mNumFaces=indicesSizes[shapeCompI]/3;
+        const int* tri=indices[shapeCompI];
+        for (int i=0;i<indicesSizes[shapeCompI]/3;i++)
         {
-            const int* tri=&(indices[shapeCompI])[0];
             aiFace& face=pMesh->mFaces[i];
             face.mIndices=new unsigned int[3];
             face.mNumIndices=3;
@@ -948,8 +2476,8 @@ void assimpExportMeshes(const std::vector<std::vector<double>>& vertices,const s
         pMesh->mNumUVComponents[0]=0;
     }
 
-    Assimp::Exporter exporter;
-    exporter.Export(&scene,format,filename);
+    PooledExporter exporter=acquireExporter();
+    return(exportScene(*exporter,&scene,format,filename,files));
 }
 
 #define LUA_EXPORTMESHES_COMMAND "simAssimp.exportMeshes"
@@ -1019,19 +2547,20 @@ SIM_DLLEXPORT void simAssimp_exportMeshes(exportMeshes_in *in, exportMeshes_out
                             }
                             if (ok)
                             {
-                                std::vector<std::vector<double>> allVertices;
-                                std::vector<std::vector<int>> allIndices;
+                                std::vector<const double*> allVertices;
+                                std::vector<int> verticesSizes;
+                                std::vector<const int*> allIndices;
+                                std::vector<int> indicesSizes;
                                 for (size_t i=0;i<l;i++)
                                 {
                                     CStackArray* vertA=allVerticesA->getArray(i);
                                     CStackArray* indA=allIndicesA->getArray(i);
-                                    const std::vector<double>* d=vertA->getDoubles();
-                                    allVertices.push_back(std::vector<double>());
-                                    for (size_t j=0;j<d->size();j++)
-                                        allVertices[allVertices.size()-1].push_back(double(d[0][j]));
-                                    allIndices.push_back(std::vector<int>(indA->getIntPointer(),indA->getIntPointer()+indA->getSize()));
+                                    allVertices.push_back(vertA->getDoubles()->data());
+                                    verticesSizes.push_back(int(vertA->getDoubles()->size()));
+                                    allIndices.push_back(indA->getIntPointer());
+                                    indicesSizes.push_back(int(indA->getSize()));
                                 }
-                                assimpExportMeshes(allVertices,allIndices,filename.c_str(),format.c_str(),scaling,upVector,options);
+                                assimpExportMeshes(int(l),allVertices.data(),verticesSizes.data(),allIndices.data(),indicesSizes.data(),filename.c_str(),format.c_str(),scaling,upVector,options);
                             }
                         }
                         else
@@ -1053,11 +2582,99 @@ SIM_DLLEXPORT void simAssimp_exportMeshes(exportMeshes_in *in, exportMeshes_out
         simSetLastError(LUA_EXPORTMESHES_COMMAND,"Not enough arguments.");
 }
 
+SIM_DLLEXPORT void simAssimp_exportMeshesToBuffer(exportMeshesToBuffer_in *in, exportMeshesToBuffer_out *out)
+{ // arguments are read directly from the stack, like with simAssimp.exportMeshes
+    CStackArray inArguments;
+    inArguments.buildFromStack(in->_.stackID);
+
+    if (inArguments.getSize()<3) throw std::runtime_error("not enough arguments");
+    if ( (!inArguments.isArray(0))||(!inArguments.isArray(1)) ) throw std::runtime_error("argument 1&2: expected tables");
+    CStackArray* allVerticesA=inArguments.getArray(0);
+    CStackArray* allIndicesA=inArguments.getArray(1);
+    if ( (allVerticesA->getSize()==0)||(allVerticesA->getSize()!=allIndicesA->getSize()) ) throw std::runtime_error("argument 1&2: expected non-empty tables");
+    std::vector<const double*> allVertices;
+    std::vector<int> verticesSizes;
+    std::vector<const int*> allIndices;
+    std::vector<int> indicesSizes;
+    for (size_t i=0;i<allVerticesA->getSize();i++)
+    {
+        if ( (!allVerticesA->isArray(i,1))||(!allIndicesA->isArray(i,1)) ) throw std::runtime_error("argument 1&2: expected tables of tables");
+        CStackArray* vertA=allVerticesA->getArray(i);
+        CStackArray* indA=allIndicesA->getArray(i);
+        allVertices.push_back(vertA->getDoubles()->data());
+        verticesSizes.push_back(int(vertA->getDoubles()->size()));
+        allIndices.push_back(indA->getIntPointer());
+        indicesSizes.push_back(int(indA->getSize()));
+    }
+    if (!inArguments.isString(2)) throw std::runtime_error("argument 3: expected string");
+    std::string format(inArguments.getString(2));
+    if (exportFormatsById.find(format)==exportFormatsById.end()) throw std::runtime_error("invalid format");
+    double scaling=1.0;
+    int upVector=1;
+    int options=0;
+    if (inArguments.getSize()>3)
+    {
+        if ( (!inArguments.isNumber(3))||(inArguments.getDouble(3)<=0.0) ) throw std::runtime_error("argument 4: invalid argument");
+        scaling=inArguments.getDouble(3);
+    }
+    if (inArguments.getSize()>4)
+    {
+        if ( (!inArguments.isNumber(4))||(inArguments.getInt(4)<1)||(inArguments.getInt(4)>2) ) throw std::runtime_error("argument 5: invalid argument");
+        upVector=inArguments.getInt(4);
+    }
+    if (inArguments.getSize()>5)
+    {
+        if ( (!inArguments.isNumber(5))||(inArguments.getInt(5)<0) ) throw std::runtime_error("argument 6: invalid argument");
+        options=inArguments.getInt(5);
+    }
+
+    std::vector<SExportedFile> files;
+    if (!assimpExportMeshes(int(allVertices.size()),allVertices.data(),verticesSizes.data(),allIndices.data(),indicesSizes.data(),"",format.c_str(),scaling,upVector,options,&files))
+        throw std::runtime_error("export failed");
+    simPopStackItem(in->_.stackID,simGetStackSize(in->_.stackID));
+    out->data=files[0].data;
+    for (size_t i=1;i<files.size();i++)
+    {
+        out->auxFileNames.push_back(files[i].name);
+        out->auxFileData.push_back(files[i].data);
+    }
+}
+
 SIM_DLLEXPORT int* assimp_importShapes(const char* fileNames,int maxTextures,double scaling,int upVector,int options,int* shapeCount)
 {
     int* retVal=nullptr;
     std::vector<int> shapeHandles;
-    assimpImportShapes(fileNames,maxTextures,scaling,upVector,options,shapeHandles);
+    assimpImportShapes(getFileSources(fileNames),maxTextures,scaling,upVector,options,0,0.0,0,shapeHandles);
+    shapeCount[0]=int(shapeHandles.size());
+    if (shapeHandles.size()>0)
+    {
+        retVal=(int*)simCreateBuffer(int(shapeHandles.size())*sizeof(int));
+        for (size_t i=0;i<shapeHandles.size();i++)
+            retVal[i]=shapeHandles[i];
+    }
+    return(retVal);
+}
+
+SIM_DLLEXPORT int* assimp_importShapesWelded(const char* fileNames,int maxTextures,double scaling,int upVector,int options,double weldTolerance,int* shapeCount)
+{ // same as assimp_importShapes, with welding (see simAssimp.importShapes). The other C entry points do not weld
+    int* retVal=nullptr;
+    std::vector<int> shapeHandles;
+    assimpImportShapes(getFileSources(fileNames),maxTextures,scaling,upVector,options,0,std::max<double>(weldTolerance,0.0),0,shapeHandles);
+    shapeCount[0]=int(shapeHandles.size());
+    if (shapeHandles.size()>0)
+    {
+        retVal=(int*)simCreateBuffer(int(shapeHandles.size())*sizeof(int));
+        for (size_t i=0;i<shapeHandles.size();i++)
+            retVal[i]=shapeHandles[i];
+    }
+    return(retVal);
+}
+
+SIM_DLLEXPORT int* assimp_importShapesFromBuffer(const char* data,int dataSize,const char* formatHint,int maxTextures,double scaling,int upVector,int options,int* shapeCount)
+{
+    int* retVal=nullptr;
+    std::vector<int> shapeHandles;
+    assimpImportShapes(getBufferSource(data,size_t(dataSize),formatHint),maxTextures,scaling,upVector,options,0,0.0,0,shapeHandles);
     shapeCount[0]=int(shapeHandles.size());
     if (shapeHandles.size()>0)
     {
@@ -1068,52 +2685,242 @@ SIM_DLLEXPORT int* assimp_importShapes(const char* fileNames,int maxTextures,dou
     return(retVal);
 }
 
+char* exportedFileToBuffer(const std::vector<SExportedFile>& files,int* dataSize)
+{ // only the main file is returned
+    dataSize[0]=0;
+    if (files.size()==0)
+        return(nullptr);
+    char* retVal=simCreateBuffer(int(files[0].data.size()));
+    memcpy(retVal,files[0].data.data(),files[0].data.size());
+    dataSize[0]=int(files[0].data.size());
+    return(retVal);
+}
+
+SIM_DLLEXPORT char* assimp_exportShapesToBuffer(const int* shapeHandles,int shapeCount,const char* format,double scaling,int upVector,int options,int* dataSize)
+{
+    std::vector<int> handles(shapeHandles,shapeHandles+shapeCount);
+    std::vector<SExportedFile> files;
+    assimpExportShapes(handles,"",format,scaling,upVector,options,&files);
+    return(exportedFileToBuffer(files,dataSize));
+}
+
+SIM_DLLEXPORT char* assimp_exportMeshesToBuffer(int meshCnt,const double** allVertices,const int* verticesSizes,const int** allIndices,const int* indicesSizes,const char* format,double scaling,int upVector,int options,int* dataSize)
+{
+    std::vector<SExportedFile> files;
+    assimpExportMeshes(meshCnt,allVertices,verticesSizes,allIndices,indicesSizes,"",format,scaling,upVector,options,&files);
+    return(exportedFileToBuffer(files,dataSize));
+}
+
+SIM_DLLEXPORT int assimp_importPointCloud(const char* fileNames,double voxelSize,double scaling,int upVector,int options,double pointSize)
+{
+    return(assimpImportPointCloud(fileNames,voxelSize,scaling,upVector,options,pointSize));
+}
+
 SIM_DLLEXPORT void assimp_exportShapes(const int* shapeHandles,int shapeCount,const char* filename,const char* format,double scaling,int upVector,int options)
 {
     std::vector<int> handles(shapeHandles,shapeHandles+shapeCount);
     assimpExportShapes(handles,filename,format,scaling,upVector,options);
 }
 
-SIM_DLLEXPORT int assimp_importMeshes(const char* fileNames,double scaling,int upVector,int options,double*** allVertices,int** verticesSizes,int*** allIndices,int** indicesSizes)
+template<typename T>
+int assimpImportMeshesToBuffers(const std::vector<SImportSource>& sources,double scaling,int upVector,int options,double weldTolerance,T*** allVertices,int** verticesSizes,int*** allIndices,int** indicesSizes)
 {
-    std::vector<std::vector<double>> _allVertices;
-    std::vector<std::vector<int>> _allIndices;
-    assimpImportMeshes(fileNames,scaling,upVector,options,_allVertices,_allIndices);
-    int retVal=int(_allVertices.size());
-    allVertices[0]=(double**)simCreateBuffer(retVal*sizeof(double*));
+    SMeshImportSession session;
+    assimpLoadMeshes(sources,scaling,upVector,options,std::max<double>(weldTolerance,0.0),session);
+    int retVal=int(session.meshes.size());
+    allVertices[0]=(T**)simCreateBuffer(retVal*sizeof(T*));
     verticesSizes[0]=(int*)simCreateBuffer(retVal*sizeof(int));
     if (allIndices!=nullptr)
     {
         allIndices[0]=(int**)simCreateBuffer(retVal*sizeof(int*));
         indicesSizes[0]=(int*)simCreateBuffer(retVal*sizeof(int));
     }
-    for (size_t i=0;i<retVal;i++)
+    for (int i=0;i<retVal;i++)
     {
-        allVertices[0][i]=(double*)simCreateBuffer(_allVertices[i].size()*sizeof(double));
-        verticesSizes[0][i]=int(_allVertices[i].size());
-        for (size_t j=0;j<_allVertices[i].size();j++)
-            allVertices[0][i][j]=_allVertices[i][j];
+        const SMeshImportSession::SMesh& m=session.meshes[i];
+        allVertices[0][i]=(T*)simCreateBuffer(int(m.verticesSize*sizeof(T)));
+        verticesSizes[0][i]=m.verticesSize;
+        writeMeshVertices(m,allVertices[0][i]);
         if (allIndices!=nullptr)
         {
-            allIndices[0][i]=(int*)simCreateBuffer(_allIndices[i].size()*sizeof(int));
-            indicesSizes[0][i]=int(_allIndices[i].size());
-            for (size_t j=0;j<_allIndices[i].size();j++)
-                allIndices[0][i][j]=_allIndices[i][j];
+            allIndices[0][i]=(int*)simCreateBuffer(int(m.indicesSize*sizeof(int)));
+            indicesSizes[0][i]=m.indicesSize;
+            writeMeshIndices(m,allIndices[0][i]);
         }
     }
     return(retVal);
 }
 
+SIM_DLLEXPORT int assimp_importMeshes(const char* fileNames,double scaling,int upVector,int options,double*** allVertices,int** verticesSizes,int*** allIndices,int** indicesSizes)
+{
+    return(assimpImportMeshesToBuffers(getFileSources(fileNames),scaling,upVector,options,0.0,allVertices,verticesSizes,allIndices,indicesSizes));
+}
+
+SIM_DLLEXPORT int assimp_importMeshesWelded(const char* fileNames,double scaling,int upVector,int options,double weldTolerance,double*** allVertices,int** verticesSizes,int*** allIndices,int** indicesSizes)
+{ // same as assimp_importMeshes, with welding (see simAssimp.importMeshes)
+    return(assimpImportMeshesToBuffers(getFileSources(fileNames),scaling,upVector,options,weldTolerance,allVertices,verticesSizes,allIndices,indicesSizes));
+}
+
+SIM_DLLEXPORT int assimp_importMeshesF(const char* fileNames,double scaling,int upVector,int options,float*** allVertices,int** verticesSizes,int*** allIndices,int** indicesSizes)
+{ // same as assimp_importMeshes, but vertices keep Assimp's single precision
+    return(assimpImportMeshesToBuffers(getFileSources(fileNames),scaling,upVector,options,0.0,allVertices,verticesSizes,allIndices,indicesSizes));
+}
+
 SIM_DLLEXPORT void assimp_exportMeshes(int meshCnt,const double** allVertices,const int* verticesSizes,const int** allIndices,const int* indicesSizes,const char* filename,const char* format,double scaling,int upVector,int options)
 {
-    std::vector<std::vector<double>> _allVertices;
-    std::vector<std::vector<int>> _allIndices;
-    for (int i=0;i<meshCnt;i++)
+    assimpExportMeshes(meshCnt,allVertices,verticesSizes,allIndices,indicesSizes,filename,format,scaling,upVector,options);
+}
+
+SIM_DLLEXPORT void assimp_exportMeshesF(int meshCnt,const float** allVertices,const int* verticesSizes,const int** allIndices,const int* indicesSizes,const char* filename,const char* format,double scaling,int upVector,int options)
+{
+    assimpExportMeshes(meshCnt,allVertices,verticesSizes,allIndices,indicesSizes,filename,format,scaling,upVector,options);
+}
+
+// Two-phase mesh import:
+// 1. assimp_importMeshesBegin reads the files and returns a session handle and the mesh count
+// 2. assimp_importMeshesGetSizes returns the vertex and index array sizes of each mesh
+// 3. either assimp_importMeshesFetch/FetchF convert into buffers supplied by the caller,
+//    or assimp_importMeshesBorrow/BorrowF return buffers owned by the session
+// 4. assimp_importMeshesEnd releases the session, and the borrowed buffers with it
+struct SMeshImportSessionBuffers
+{
+    SMeshImportSession session;
+    std::vector<std::vector<double>> vertices;
+    std::vector<std::vector<float>> verticesF;
+    std::vector<std::vector<int>> indices;
+    std::vector<const double*> vertexPointers;
+    std::vector<const float*> vertexPointersF;
+    std::vector<const int*> indexPointers;
+};
+std::map<int,std::unique_ptr<SMeshImportSessionBuffers>> meshImportSessions;
+int nextMeshImportSessionHandle=1;
+
+SMeshImportSessionBuffers* getMeshImportSession(int sessionHandle)
+{
+    std::map<int,std::unique_ptr<SMeshImportSessionBuffers>>::iterator it=meshImportSessions.find(sessionHandle);
+    if (it==meshImportSessions.end())
+        return(nullptr);
+    return(it->second.get());
+}
+
+template<typename T>
+int fetchSessionMeshes(int sessionHandle,T** allVertices,int** allIndices)
+{
+    SMeshImportSessionBuffers* s=getMeshImportSession(sessionHandle);
+    if (s==nullptr)
+        return(0);
+    for (size_t i=0;i<s->session.meshes.size();i++)
+    {
+        if ( (allVertices!=nullptr)&&(allVertices[i]!=nullptr) )
+            writeMeshVertices(s->session.meshes[i],allVertices[i]);
+        if ( (allIndices!=nullptr)&&(allIndices[i]!=nullptr) )
+            writeMeshIndices(s->session.meshes[i],allIndices[i]);
+    }
+    return(1);
+}
+
+template<typename T>
+int borrowSessionMeshes(int sessionHandle,std::vector<std::vector<T>> SMeshImportSessionBuffers::*vertices,std::vector<const T*> SMeshImportSessionBuffers::*vertexPointers,const T*** allVertices,const int*** allIndices)
+{
+    SMeshImportSessionBuffers* s=getMeshImportSession(sessionHandle);
+    if (s==nullptr)
+        return(0);
+    size_t cnt=s->session.meshes.size();
+    if ( (allVertices!=nullptr)&&((s->*vertexPointers).size()!=cnt) )
+    { // converted once, on first request
+        (s->*vertices).resize(cnt);
+        for (size_t i=0;i<cnt;i++)
+        {
+            (s->*vertices)[i].resize(s->session.meshes[i].verticesSize);
+            writeMeshVertices(s->session.meshes[i],(s->*vertices)[i].data());
+            (s->*vertexPointers).push_back((s->*vertices)[i].data());
+        }
+    }
+    if ( (allIndices!=nullptr)&&(s->indexPointers.size()!=cnt) )
+    {
+        s->indices.resize(cnt);
+        for (size_t i=0;i<cnt;i++)
+        {
+            s->indices[i].resize(s->session.meshes[i].indicesSize);
+            writeMeshIndices(s->session.meshes[i],s->indices[i].data());
+            s->indexPointers.push_back(s->indices[i].data());
+        }
+    }
+    if (allVertices!=nullptr)
+        allVertices[0]=(s->*vertexPointers).data();
+    if (allIndices!=nullptr)
+        allIndices[0]=s->indexPointers.data();
+    return(1);
+}
+
+SIM_DLLEXPORT int assimp_importMeshesBegin(const char* fileNames,double scaling,int upVector,int options,int* meshCount)
+{
+    std::unique_ptr<SMeshImportSessionBuffers> s(new SMeshImportSessionBuffers());
+    assimpLoadMeshes(getFileSources(fileNames),scaling,upVector,options,0.0,s->session);
+    meshCount[0]=int(s->session.meshes.size());
+    int retVal=nextMeshImportSessionHandle++;
+    meshImportSessions[retVal]=std::move(s);
+    return(retVal);
+}
+
+SIM_DLLEXPORT int assimp_importMeshesBeginWelded(const char* fileNames,double scaling,int upVector,int options,double weldTolerance,int* meshCount)
+{ // same as assimp_importMeshesBegin, with welding (see simAssimp.importMeshes)
+    std::unique_ptr<SMeshImportSessionBuffers> s(new SMeshImportSessionBuffers());
+    assimpLoadMeshes(getFileSources(fileNames),scaling,upVector,options,std::max<double>(weldTolerance,0.0),s->session);
+    meshCount[0]=int(s->session.meshes.size());
+    int retVal=nextMeshImportSessionHandle++;
+    meshImportSessions[retVal]=std::move(s);
+    return(retVal);
+}
+
+SIM_DLLEXPORT int assimp_importMeshesBeginFromBuffer(const char* data,int dataSize,const char* formatHint,double scaling,int upVector,int options,int* meshCount)
+{
+    std::unique_ptr<SMeshImportSessionBuffers> s(new SMeshImportSessionBuffers());
+    assimpLoadMeshes(getBufferSource(data,size_t(dataSize),formatHint),scaling,upVector,options,0.0,s->session);
+    meshCount[0]=int(s->session.meshes.size());
+    int retVal=nextMeshImportSessionHandle++;
+    meshImportSessions[retVal]=std::move(s);
+    return(retVal);
+}
+
+SIM_DLLEXPORT int assimp_importMeshesGetSizes(int sessionHandle,int* verticesSizes,int* indicesSizes)
+{
+    SMeshImportSessionBuffers* s=getMeshImportSession(sessionHandle);
+    if (s==nullptr)
+        return(0);
+    for (size_t i=0;i<s->session.meshes.size();i++)
     {
-        _allVertices.push_back(std::vector<double>(allVertices[i],allVertices[i]+verticesSizes[i]));
-        _allIndices.push_back(std::vector<int>(allIndices[i],allIndices[i]+indicesSizes[i]));
+        if (verticesSizes!=nullptr)
+            verticesSizes[i]=s->session.meshes[i].verticesSize;
+        if (indicesSizes!=nullptr)
+            indicesSizes[i]=s->session.meshes[i].indicesSize;
     }
-    assimpExportMeshes(_allVertices,_allIndices,filename,format,scaling,upVector,options);
+    return(1);
+}
+
+SIM_DLLEXPORT int assimp_importMeshesFetch(int sessionHandle,double** allVertices,int** allIndices)
+{
+    return(fetchSessionMeshes(sessionHandle,allVertices,allIndices));
+}
+
+SIM_DLLEXPORT int assimp_importMeshesFetchF(int sessionHandle,float** allVertices,int** allIndices)
+{
+    return(fetchSessionMeshes(sessionHandle,allVertices,allIndices));
+}
+
+SIM_DLLEXPORT int assimp_importMeshesBorrow(int sessionHandle,const double*** allVertices,const int*** allIndices)
+{
+    return(borrowSessionMeshes(sessionHandle,&SMeshImportSessionBuffers::vertices,&SMeshImportSessionBuffers::vertexPointers,allVertices,allIndices));
+}
+
+SIM_DLLEXPORT int assimp_importMeshesBorrowF(int sessionHandle,const float*** allVertices,const int*** allIndices)
+{
+    return(borrowSessionMeshes(sessionHandle,&SMeshImportSessionBuffers::verticesF,&SMeshImportSessionBuffers::vertexPointersF,allVertices,allIndices));
+}
+
+SIM_DLLEXPORT void assimp_importMeshesEnd(int sessionHandle)
+{
+    meshImportSessions.erase(sessionHandle);
 }
 
 class Plugin : public sim::Plugin
@@ -1126,6 +2933,18 @@ public:
 
         setExtVersion("Assimp-based CAD Import Plugin");
         setBuildDate(BUILD_DATE);
+
+        buildFormatRegistry();
+    }
+
+    void onCleanup()
+    {
+        meshImportSessions.clear();
+        exportSessions.clear();
+        recordings.clear();
+        clearImporterPool();
+        std::lock_guard<std::mutex> lock(exporterPoolMutex);
+        exporterPool.clear();
     }
 };
 